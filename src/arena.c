@@ -0,0 +1,97 @@
+#include "arena.h"
+
+#include <stdbool.h>
+
+#include "xmalloc.h"
+#include "failure.h"
+
+typedef struct chunk_s chunk_t;
+struct chunk_s
+{
+    chunk_t *next;
+    size_t size;
+    size_t used;
+    _Alignas(ARENA_ALIGNMENT) uint8_t memory[];
+};
+
+struct arena_s
+{
+    chunk_t *chunks; // Last allocated chunk first
+    size_t chunk_size;
+    arena_t *previous; // Arena entered before this one
+};
+
+static _Thread_local arena_t *current = NULL;
+
+/*********************************************************************/
+
+arena_t *arena_init(size_t chunk_size)
+{
+    arena_t *arena = xmalloc(sizeof(arena_t));
+    arena->chunks = NULL;
+    arena->chunk_size = chunk_size > 0 ? arena_round(chunk_size) : ARENA_DEFAULT_CHUNK;
+    arena->previous = NULL;
+    return arena;
+}
+
+void *arena_alloc(arena_t *arena, size_t size)
+{
+    size = arena_round(size > 0 ? size : 1);
+
+    chunk_t *chunk = arena->chunks;
+    if (chunk == NULL || chunk->size - chunk->used < size)
+    {
+        // The first chunk has the requested size, so an arena sized beforehand is a single block
+        size_t chunk_size = arena->chunk_size;
+        if (chunk != NULL)
+            chunk_size = chunk->size * 2;
+        if (chunk_size < size)
+            chunk_size = size;
+
+        chunk = xmalloc(sizeof(chunk_t) + chunk_size);
+        chunk->size = chunk_size;
+        chunk->used = 0;
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+    }
+
+    void *memory = chunk->memory + chunk->used;
+    chunk->used += size;
+    return memory;
+}
+
+void arena_destroy(arena_t *arena)
+{
+    if (arena == NULL)
+        return;
+
+    chunk_t *chunk = arena->chunks;
+    while (chunk != NULL)
+    {
+        chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(arena);
+}
+
+void arena_enter(arena_t *arena)
+{
+    arena->previous = current;
+    current = arena;
+}
+
+void arena_leave(void)
+{
+    if (current == NULL)
+    {
+        fail_error("Leaving an arena never entered");
+        abort();
+    }
+    current = current->previous;
+}
+
+arena_t *arena_current(void)
+{
+    return current;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+
+// Alignment of every allocation in an arena
+#define ARENA_ALIGNMENT 16
+// Size of the first chunk of an arena, the following chunks double
+#define ARENA_DEFAULT_CHUNK 4096
+
+// Size taken by an allocation in an arena
+#define arena_round(size) (((size) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+typedef struct arena_s arena_t;
+
+/**
+ * @brief Initialise an empty arena
+ *
+ * @param chunk_size Size of the first chunk, allocated on the first allocation
+ * @return arena_t* The new arena
+ */
+arena_t *arena_init(size_t chunk_size);
+
+/**
+ * @brief Allocate memory from an arena. It is only freed with the arena
+ *
+ * @param arena The arena
+ * @param size Size in bytes
+ * @return void* The memory, aligned on ARENA_ALIGNMENT
+ */
+void *arena_alloc(arena_t *arena, size_t size);
+
+/**
+ * @brief Free an arena and everything allocated from it
+ *
+ * @param arena The arena, invalid after the call
+ */
+void arena_destroy(arena_t *arena);
+
+/**
+ * @brief Make the dynamic arrays initialised on the calling thread come from an arena, until arena_leave
+ *
+ * @details The calls can be nested, arena_leave goes back to the previous arena
+ *
+ * @param arena The arena
+ */
+void arena_enter(arena_t *arena);
+
+/**
+ * @brief Go back to the arena used before the last arena_enter of the calling thread
+ */
+void arena_leave(void);
+
+/**
+ * @brief Get the arena the dynamic arrays of the calling thread come from
+ *
+ * @return arena_t* The arena, NULL for the heap
+ */
+arena_t *arena_current(void);
@@ -19,7 +19,6 @@ static void xmalloc_callback(int err);
 bit_elem_t *bit_elem_init(BPTYPE_t type, size_t width, void *data)
 {
     bit_elem_t *new_bit_elem = NULL;
-    int data_len = 0;
     bit_const_t *bc_val = NULL;
     enumeration_t *enum_val = NULL;
 
@@ -32,75 +31,59 @@ bit_elem_t *bit_elem_init(BPTYPE_t type, size_t width, void *data)
     case eBP_LABEL_ABS:
     case eBP_IMMEDIATE:
         // Expects no data
-        new_bit_elem = xmalloc(sizeof(bit_elem_t) + 0);
+        new_bit_elem = xmalloc(sizeof(bit_elem_t));
         new_bit_elem->index_mnemonic = 0;
-        new_bit_elem->data_len = 0;
         new_bit_elem->width = width;
         break;
 
     case eBP_ID:
         // Expects no data
-        new_bit_elem = xmalloc(sizeof(bit_elem_t) + 0);
+        new_bit_elem = xmalloc(sizeof(bit_elem_t));
         new_bit_elem->index_mnemonic = -1; // Non variable
-        new_bit_elem->data_len = 0;
         new_bit_elem->width = width;
         break;
 
     case eBP_ENUM:
-
-        // Resolve the name
+        // Expects the name of the enum, resolve it
         enum_val = ((enumeration_t *)hash_get(enum_array, (char *)data));
-
-        // Expects the name of the enum
-        data_len = sizeof(enumeration_t) + strlen(enum_val->name) + 1;
         if (!enum_val)
         {
             fail_error("'%s' has never been declared", (char *)data);
-            break;
+            return NULL;
         }
-        new_bit_elem = xmalloc(sizeof(bit_elem_t) + data_len);
+        new_bit_elem = xmalloc(sizeof(bit_elem_t));
         new_bit_elem->index_mnemonic = 0;
-        new_bit_elem->data_len = data_len;
         new_bit_elem->width = enum_val->width;
-        memcpy(new_bit_elem->data, enum_val, data_len);
+        new_bit_elem->enumeration = enum_val;
         break;
 
     case eBP_BIT_CONST:
-        // Expects the name of the bit constant
-        data_len = sizeof(bit_const_t);
-
-        // Resolve the name
+        // Expects the name of the bit constant, resolve it
         bc_val = ((bit_const_t *)hash_get(bit_const_array, (char *)data));
         if (!bc_val)
         {
             fail_error("'%s' has never been declared", (char *)data);
-            break;
+            return NULL;
         }
-        new_bit_elem = xmalloc(sizeof(bit_elem_t) + data_len);
+        new_bit_elem = xmalloc(sizeof(bit_elem_t));
         new_bit_elem->index_mnemonic = -1; // Non variable
-        new_bit_elem->data_len = data_len;
         new_bit_elem->width = bc_val->width;
-        memcpy(new_bit_elem->data, bc_val, data_len);
+        new_bit_elem->bit_const = *bc_val;
         break;
 
     case eBP_BIT_LIT:
         // Expects a bit literal
-        data_len = sizeof(bit_const_t);
-
-        // Resolve the name
         bc_val = (bit_const_t *)data;
-        new_bit_elem = xmalloc(sizeof(bit_elem_t) + data_len);
+        new_bit_elem = xmalloc(sizeof(bit_elem_t));
         new_bit_elem->index_mnemonic = -1; // Non variable
-        new_bit_elem->data_len = data_len;
         new_bit_elem->width = bc_val->width;
-        memcpy(new_bit_elem->data, bc_val, data_len);
+        new_bit_elem->bit_const = *bc_val;
         break;
 
     case eBP_ELLIPSIS:
         // Expects no data
-        new_bit_elem = xmalloc(sizeof(bit_elem_t) + 0);
+        new_bit_elem = xmalloc(sizeof(bit_elem_t));
         new_bit_elem->index_mnemonic = -1; // Non variable
-        new_bit_elem->data_len = 0;
         new_bit_elem->width = 0;
         break;
 
@@ -108,6 +91,98 @@ bit_elem_t *bit_elem_init(BPTYPE_t type, size_t width, void *data)
         return NULL;
     }
     new_bit_elem->type = type;
+    new_bit_elem->index_opcode = 0;
+    new_bit_elem->offset = 0;
+    new_bit_elem->mask = 0;
+    return new_bit_elem;
+}
+
+bit_pattern_t *bit_pattern_init(linked_list_t *list)
+{
+    xmalloc_set_handler(xmalloc_callback);
+
+    bit_pattern_t *pattern = xmalloc(sizeof(bit_pattern_t));
+    pattern->count = list_get_lenght(list);
+    pattern->argument_count = 0;
+    pattern->id_index = -1;
+    pattern->base = 0;
+    pattern->fixed = 0;
+    pattern->elems = xmalloc(sizeof(bit_elem_t) * pattern->count);
+    pattern->mnemonic_order = NULL;
+
+    int count = 0;
+    while (list != NULL)
+    {
+        linked_list_t *next = list->next;
+        // The elements that failed to resolve are already reported
+        if (list->user_data != NULL)
+        {
+            pattern->elems[count++] = *(bit_elem_t *)(list->user_data);
+            free(list->user_data);
+        }
+        list_destroy(list);
+        list = next;
+    }
+    pattern->count = count;
+
+    return pattern;
+}
+
+void bit_pattern_layout(bit_pattern_t *pattern)
+{
+    // The offsets grow from the last element
+    int offset = 0;
+    for (int i = pattern->count - 1; i >= 0; i--)
+    {
+        bit_elem_t *bit_elem = &pattern->elems[i];
+        bit_elem->offset = offset;
+        bit_elem->mask = (0xFFFFFFFFFFFFFFFFLLU << offset);
+        bit_elem->mask &= ~(0xFFFFFFFFFFFFFFFFLLU << (offset + bit_elem->width));
+        offset += bit_elem->width;
+
+        if (bit_elem->type == eBP_BIT_CONST || bit_elem->type == eBP_BIT_LIT)
+            pattern->base |= (bit_elem->bit_const.val << bit_elem->offset) & bit_elem->mask;
+        // The ellipsis is filled with zeros
+        if (bit_elem->type == eBP_BIT_CONST || bit_elem->type == eBP_BIT_LIT || bit_elem->type == eBP_ID || bit_elem->type == eBP_ELLIPSIS)
+            pattern->fixed |= bit_elem->mask;
+    }
+}
+
+void bit_pattern_index_mnemonic(bit_pattern_t *pattern)
+{
+    xmalloc_set_handler(xmalloc_callback);
+
+    pattern->argument_count = 0;
+    for (int i = 0; i < pattern->count; i++)
+    {
+        if (pattern->elems[i].index_mnemonic >= 0)
+            pattern->argument_count++;
+    }
+
+    free(pattern->mnemonic_order);
+    pattern->mnemonic_order = NULL;
+    if (pattern->argument_count == 0)
+        return;
+
+    pattern->mnemonic_order = xmalloc(sizeof(int) * pattern->argument_count);
+    for (int i = 0; i < pattern->argument_count; i++)
+        pattern->mnemonic_order[i] = -1;
+    for (int i = 0; i < pattern->count; i++)
+    {
+        int index = pattern->elems[i].index_mnemonic;
+        if (index >= 0 && index < pattern->argument_count)
+            pattern->mnemonic_order[index] = i;
+    }
+}
+
+uint64_t bit_pattern_opcode_base(opcode_t const *opcode)
+{
+    bit_pattern_t const *format = opcode->format;
+    if (format->id_index < 0)
+        return format->base;
+
+    bit_elem_t const *id_elem = &format->elems[format->id_index];
+    return format->base | ((opcode->id.val << id_elem->offset) & id_elem->mask);
 }
 
 /********************************************************/
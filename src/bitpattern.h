@@ -32,10 +32,26 @@ typedef struct bit_elem_s
     size_t width;
     int index_opcode;
     int index_mnemonic;
-    size_t data_len;
-    uint8_t data[]; //Hold the data 
+    int offset;    // Position of the least significant bit in the opcode, set by command_format
+    uint64_t mask; // Bits of the opcode covered by the element, set by command_format
+    union
+    {
+        bit_const_t bit_const;      // eBP_BIT_CONST and eBP_BIT_LIT
+        enumeration_t *enumeration; // eBP_ENUM
+    };
 } bit_elem_t;
 
+struct bit_pattern_s
+{
+    int count;           // Number of elements
+    int argument_count;  // Number of elements that are arguments of the mnemonic
+    int id_index;        // Index in elems of the ID() substitution, -1 without one
+    uint64_t base;       // Bits set by the constants, set by command_format
+    uint64_t fixed;      // Bits of the constants, the ID() and the ellipsis, set by command_format
+    bit_elem_t *elems;   // Elements in opcode order, index_opcode is the index in this array
+    int *mnemonic_order; // Index in elems of each argument, in mnemonic order. -1 when an argument is missing
+};
+
 /**
  * @brief Create the corresponding bitpattern element
  * 
@@ -44,4 +60,35 @@ typedef struct bit_elem_s
  * @param data The corresponding data
  * @return bit_elem_t* Return a pointer to the newly created bitpattern element
  */
-bit_elem_t *bit_elem_init(BPTYPE_t type, size_t width, void *data);
\ No newline at end of file
+bit_elem_t *bit_elem_init(BPTYPE_t type, size_t width, void *data);
+
+/**
+ * @brief Copy a list of bitpattern elements to a contiguous bitpattern, and free the list
+ *
+ * @param list The list of bit_elem_t, as parsed
+ * @return bit_pattern_t* The new bitpattern, its offsets, masks and mnemonic order are not computed yet
+ */
+bit_pattern_t *bit_pattern_init(linked_list_t *list);
+
+/**
+ * @brief Compute the offset and the mask of each element, the bits set by the constants and the bits that do not
+ * depend on the arguments. The last element is the least significant
+ *
+ * @param pattern The bitpattern, with the final widths
+ */
+void bit_pattern_layout(bit_pattern_t *pattern);
+
+/**
+ * @brief Compute the mnemonic order from the index_mnemonic of the elements
+ *
+ * @param pattern The bitpattern
+ */
+void bit_pattern_index_mnemonic(bit_pattern_t *pattern);
+
+/**
+ * @brief Get the bits of an opcode that do not depend on its arguments
+ *
+ * @param opcode The opcode
+ * @return uint64_t The bits set by the constants of its format and by its id
+ */
+uint64_t bit_pattern_opcode_base(opcode_t const *opcode);
@@ -0,0 +1,304 @@
+#include "cache.h"
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "version.h"
+#include "parameters.h"
+#include "failure.h"
+
+// Increase when the layout of the cached files changes
+#define CACHE_FORMAT 1
+#define CACHE_MAGIC "ASSDFA1"
+#define COPY_BUFFER_SIZE 65536
+
+static char const *directory = NULL;
+
+// Path of a cached file
+static void cache_path(char *path, size_t size, uint64_t key, char const *kind);
+// Write a file under a temporary name and rename it, so concurrent builds never see a partial file
+static FILE *cache_open_temporary(char *temporary, size_t size, char const *path);
+static void cache_commit_temporary(FILE *fd, char const *temporary, char const *path);
+// Read a 32 bits integer, return false at the end of the file
+static bool read_int(FILE *fd, int32_t *value);
+static void write_int(FILE *fd, int32_t value);
+
+/*********************************************************************/
+
+void cache_set_directory(char const *dir)
+{
+    directory = dir;
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST)
+    {
+        fail_warning("%s (%s), the cache is disabled", strerror(errno), dir);
+        directory = NULL;
+    }
+}
+
+bool cache_enabled(void)
+{
+    return directory != NULL;
+}
+
+uint64_t cache_hash(uint64_t hash, void const *data, size_t length)
+{
+    unsigned char const *bytes = data;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3LLU;
+    }
+    return hash;
+}
+
+uint64_t cache_hash_string(uint64_t hash, char const *str)
+{
+    if (str == NULL)
+        return cache_hash(hash, "\xFF", 1);
+    return cache_hash(hash, str, strlen(str) + 1);
+}
+
+uint64_t cache_hash_version(uint64_t hash)
+{
+    int const version[] = {CACHE_FORMAT, VERSION_MAJOR, VERSION_MINOR, VERSION_REVISION, VERSION_BUILD, VERSION_BUILD_DATE};
+    return cache_hash(hash, version, sizeof(version));
+}
+
+uint64_t cache_hash_input(uint64_t hash, int count, char **files)
+{
+    char buffer[COPY_BUFFER_SIZE];
+    size_t length;
+
+    // Same rule as parse_file
+    if (count <= 0 || !isatty(fileno(stdin)))
+    {
+        // Keep a copy to put back in place of the standard input
+        FILE *copy = tmpfile();
+        if (copy == NULL)
+        {
+            fail_error("%s (while reading the standard input)", strerror(errno));
+            return hash;
+        }
+
+        while ((length = fread(buffer, 1, sizeof(buffer), stdin)) > 0)
+        {
+            hash = cache_hash(hash, buffer, length);
+            fwrite(buffer, 1, length, copy);
+        }
+
+        fflush(copy);
+        rewind(copy);
+        dup2(fileno(copy), STDIN_FILENO);
+        clearerr(stdin);
+        fclose(copy);
+        return hash;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        FILE *fd = fopen(files[i], "rb");
+        if (fd == NULL)
+        {
+            fail_error("%s (%s)", strerror(errno), files[i]);
+            continue;
+        }
+
+        hash = cache_hash_string(hash, files[i]);
+        while ((length = fread(buffer, 1, sizeof(buffer), fd)) > 0)
+            hash = cache_hash(hash, buffer, length);
+        fclose(fd);
+    }
+    return hash;
+}
+
+uint64_t cache_hash_parameters(uint64_t hash)
+{
+    // The strings are hashed by value, the padding of the structure is not
+    int64_t const widths[] = {parameters.opcode_width, parameters.memory_width, parameters.alignment,
+                              parameters.address_width, parameters.address_start, parameters.address_stop,
+                              parameters.endianness};
+    hash = cache_hash(hash, widths, sizeof(widths));
+    hash = cache_hash(hash, &parameters.args_separator, 1);
+    hash = cache_hash(hash, &parameters.label_postfix, 1);
+
+    char const *strings[] = {parameters.constant_dir, parameters.macro_dir, parameters.author, parameters.version,
+                             parameters.name, parameters.copyright, parameters.description};
+    for (size_t i = 0; i < sizeof(strings) / sizeof(strings[0]); i++)
+        hash = cache_hash_string(hash, strings[i]);
+    return hash;
+}
+
+bool cache_load_machine(char const *kind, uint64_t key, state_machine_t *state_machine)
+{
+    if (directory == NULL)
+        return false;
+
+    char path[strlen(directory) + 64];
+    cache_path(path, sizeof(path), key, kind);
+    FILE *fd = fopen(path, "rb");
+    if (fd == NULL)
+        return false;
+
+    char magic[sizeof(CACHE_MAGIC)];
+    uint64_t stored_key;
+    int32_t count;
+    bool valid = fread(magic, 1, sizeof(magic), fd) == sizeof(magic) && memcmp(magic, CACHE_MAGIC, sizeof(magic)) == 0 &&
+                 fread(&stored_key, sizeof(stored_key), 1, fd) == 1 && stored_key == key &&
+                 read_int(fd, &count) && count > 0;
+
+    state_machine->states_tstate = darray_init(sizeof(state_t));
+    state_machine->arena = NULL;
+    for (int32_t i = 0; valid && i < count; i++)
+    {
+        int32_t id, end_state, output, transitions;
+        valid = read_int(fd, &id) && read_int(fd, &end_state) && read_int(fd, &output) && read_int(fd, &transitions);
+        if (!valid)
+            break;
+
+        state_t state = state_init_state(id);
+        state.end_state = end_state;
+        state.output = output;
+        for (int32_t j = 0; valid && j < transitions; j++)
+        {
+            int32_t condition, next_state_id;
+            valid = read_int(fd, &condition) && read_int(fd, &next_state_id);
+            if (valid)
+                state_add_transition(&state, next_state_id, condition);
+        }
+        // Kept even when truncated, so it is freed with the machine
+        darray_add(&(state_machine->states_tstate), state);
+    }
+    fclose(fd);
+
+    // A damaged file is regenerated
+    if (!valid)
+    {
+        state_machine_destroy(state_machine);
+        fail_debug("Ignoring the damaged cache file %s", path);
+        return false;
+    }
+
+    fail_debug("Loaded the %s state machine from %s", kind, path);
+    return true;
+}
+
+void cache_store_machine(char const *kind, uint64_t key, state_machine_t *state_machine)
+{
+    if (directory == NULL)
+        return;
+
+    char path[strlen(directory) + 64];
+    char temporary[strlen(directory) + 96];
+    cache_path(path, sizeof(path), key, kind);
+    FILE *fd = cache_open_temporary(temporary, sizeof(temporary), path);
+    if (fd == NULL)
+        return;
+
+    fwrite(CACHE_MAGIC, 1, sizeof(CACHE_MAGIC), fd);
+    fwrite(&key, sizeof(key), 1, fd);
+    write_int(fd, state_machine->states_tstate->count);
+    for (size_t i = 0; i < state_machine->states_tstate->count; i++)
+    {
+        state_t *state = darray_get_ptr(&(state_machine->states_tstate), i);
+        write_int(fd, state->id);
+        write_int(fd, state->end_state);
+        write_int(fd, state->output);
+        write_int(fd, state->transitions_ttrans->count);
+
+        transistion_t *transitions = darray_get_ptr(&(state->transitions_ttrans), 0);
+        for (size_t j = 0; j < state->transitions_ttrans->count; j++)
+        {
+            write_int(fd, transitions[j].condition);
+            write_int(fd, transitions[j].next_state_id);
+        }
+    }
+
+    cache_commit_temporary(fd, temporary, path);
+}
+
+bool cache_load_output(uint64_t key, FILE *fd)
+{
+    if (directory == NULL)
+        return false;
+
+    char path[strlen(directory) + 64];
+    cache_path(path, sizeof(path), key, "c");
+    FILE *cached = fopen(path, "rb");
+    if (cached == NULL)
+        return false;
+
+    char buffer[COPY_BUFFER_SIZE];
+    size_t length;
+    bool written = true;
+    while ((length = fread(buffer, 1, sizeof(buffer), cached)) > 0)
+        written &= fwrite(buffer, 1, length, fd) == length;
+    fclose(cached);
+
+    if (!written)
+        fail_error("%s (while writing the output file)", strerror(errno));
+    else
+        fail_debug("Copied the output from %s", path);
+    return true;
+}
+
+void cache_store_output(uint64_t key, char const *path)
+{
+    if (directory == NULL)
+        return;
+
+    FILE *generated = fopen(path, "rb");
+    if (generated == NULL)
+        return;
+
+    char cached_path[strlen(directory) + 64];
+    char temporary[strlen(directory) + 96];
+    cache_path(cached_path, sizeof(cached_path), key, "c");
+    FILE *fd = cache_open_temporary(temporary, sizeof(temporary), cached_path);
+    if (fd != NULL)
+    {
+        char buffer[COPY_BUFFER_SIZE];
+        size_t length;
+        while ((length = fread(buffer, 1, sizeof(buffer), generated)) > 0)
+            fwrite(buffer, 1, length, fd);
+        cache_commit_temporary(fd, temporary, cached_path);
+    }
+    fclose(generated);
+}
+
+/*********************************************************************/
+
+static void cache_path(char *path, size_t size, uint64_t key, char const *kind)
+{
+    snprintf(path, size, "%s/%016llx.%s", directory, (unsigned long long)key, kind);
+}
+
+static FILE *cache_open_temporary(char *temporary, size_t size, char const *path)
+{
+    snprintf(temporary, size, "%s.%ld.tmp", path, (long)getpid());
+    FILE *fd = fopen(temporary, "wb");
+    if (fd == NULL)
+        fail_warning("%s (%s), the result is not cached", strerror(errno), temporary);
+    return fd;
+}
+
+static void cache_commit_temporary(FILE *fd, char const *temporary, char const *path)
+{
+    bool failed = ferror(fd);
+    if (fclose(fd) != 0 || failed || rename(temporary, path) != 0)
+    {
+        fail_warning("%s (%s), the result is not cached", strerror(errno), path);
+        remove(temporary);
+    }
+}
+
+static bool read_int(FILE *fd, int32_t *value)
+{
+    return fread(value, sizeof(*value), 1, fd) == 1;
+}
+
+static void write_int(FILE *fd, int32_t value)
+{
+    fwrite(&value, sizeof(value), 1, fd);
+}
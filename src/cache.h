@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "state_machine.h"
+
+// Initial value of the FNV-1a hashes used as cache keys
+#define CACHE_HASH_INIT 0xCBF29CE484222325LLU
+
+/**
+ * @brief Store the generation results in a directory, and reuse them when the inputs did not change
+ *
+ * @param dir The cache directory, created if it does not exist
+ */
+void cache_set_directory(char const *dir);
+
+/**
+ * @brief Check if a cache directory has been set
+ *
+ * @return true if cache_set_directory has been called
+ */
+bool cache_enabled(void);
+
+/**
+ * @brief Add bytes to a FNV-1a hash
+ *
+ * @param hash The hash so far, CACHE_HASH_INIT for a new one
+ * @param data The bytes to add
+ * @param length Number of bytes
+ * @return uint64_t The new hash
+ */
+uint64_t cache_hash(uint64_t hash, void const *data, size_t length);
+
+/**
+ * @brief Add a string to a FNV-1a hash, NULL is distinct from every string
+ *
+ * @param hash The hash so far
+ * @param str The string, with its terminating NUL
+ * @return uint64_t The new hash
+ */
+uint64_t cache_hash_string(uint64_t hash, char const *str);
+
+/**
+ * @brief Add the version of ass and the format of the cache to a hash
+ *
+ * @param hash The hash so far
+ * @return uint64_t The new hash
+ */
+uint64_t cache_hash_version(uint64_t hash);
+
+/**
+ * @brief Add the contents of the specification to a hash, before it is parsed
+ *
+ * @details Standard input is read in full and put back, so the parser still reads it afterwards
+ *
+ * @param hash The hash so far
+ * @param count Number of input files
+ * @param files The input files, standard input is used like parse_file does
+ * @return uint64_t The new hash
+ */
+uint64_t cache_hash_input(uint64_t hash, int count, char **files);
+
+/**
+ * @brief Add the parameters set by the specification to a hash
+ *
+ * @param hash The hash so far
+ * @return uint64_t The new hash
+ */
+uint64_t cache_hash_parameters(uint64_t hash);
+
+/**
+ * @brief Load a minimised state machine from the cache
+ *
+ * @param kind Kind of the state machine, part of the file name
+ * @param key Hash of everything the state machine is built from
+ * @param state_machine Filled with the state machine on success
+ * @return true if it was found in the cache
+ */
+bool cache_load_machine(char const *kind, uint64_t key, state_machine_t *state_machine);
+
+/**
+ * @brief Store a minimised state machine in the cache. Failures are only warnings
+ *
+ * @param kind Kind of the state machine, part of the file name
+ * @param key Hash of everything the state machine is built from
+ * @param state_machine The state machine
+ */
+void cache_store_machine(char const *kind, uint64_t key, state_machine_t *state_machine);
+
+/**
+ * @brief Copy a generated file from the cache
+ *
+ * @param key Hash of everything the file is generated from
+ * @param fd The file descriptor to write to
+ * @return true if it was found in the cache and written
+ */
+bool cache_load_output(uint64_t key, FILE *fd);
+
+/**
+ * @brief Copy a generated file to the cache. Failures are only warnings
+ *
+ * @param key Hash of everything the file is generated from
+ * @param path Path of the generated file
+ */
+void cache_store_output(uint64_t key, char const *path);
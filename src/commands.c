@@ -2,6 +2,7 @@
 
 #include <string.h>
 
+#include "bitpattern.h"
 #include "failure.h"
 #include "xmalloc.h"
 #include "macro.h"
@@ -109,37 +110,38 @@ int command_format(data_t *id, linked_list_t *list)
         return 1;
     }
 
+    // Store the elements contiguously
+    bit_pattern_t *pattern = bit_pattern_init(list);
+
     // Number the elements in order, compute the width and extract the ellipsis
     bool has_id = false;
     int width = 0;
-    linked_list_t *current = list;
-    int index_opcode = 0;
     int index_mnemonic = 0;
     bit_elem_t *ellipsis = NULL;
-    while (current != NULL)
+    for (int index_opcode = 0; index_opcode < pattern->count; index_opcode++)
     {
-        width += ((bit_elem_t *)(current->user_data))->width;
+        bit_elem_t *bit_elem = &pattern->elems[index_opcode];
+        width += bit_elem->width;
         // Skip non-arguments
-        if (((bit_elem_t *)(current->user_data))->index_mnemonic >= 0)
+        if (bit_elem->index_mnemonic >= 0)
         {
-            ((bit_elem_t *)(current->user_data))->index_mnemonic = index_mnemonic;
+            bit_elem->index_mnemonic = index_mnemonic;
             index_mnemonic++;
         }
-        ((bit_elem_t *)(current->user_data))->index_opcode = index_opcode;
-        index_opcode++;
+        bit_elem->index_opcode = index_opcode;
 
         // Check for multiple ellipsis
-        if (((bit_elem_t *)(current->user_data))->type == eBP_ELLIPSIS)
+        if (bit_elem->type == eBP_ELLIPSIS)
         {
             if (ellipsis != NULL)
             {
                 fail_error("Multiple ellipsis (...) in a bit format.");
                 return 1;
             }
-            ellipsis = ((bit_elem_t *)(current->user_data));
+            ellipsis = bit_elem;
         }
         // Check for multiple ID
-        else if (((bit_elem_t *)(current->user_data))->type == eBP_ID)
+        else if (bit_elem->type == eBP_ID)
         {
             if (has_id)
             {
@@ -147,13 +149,11 @@ int command_format(data_t *id, linked_list_t *list)
                 return 1;
             }
             has_id = true;
+            pattern->id_index = index_opcode;
         }
 
         //Log a details message specifing the width and the type of the element
-        fail_debug("Element %d: %d bits, type %s", index_opcode, ((bit_elem_t*)(current->user_data))->width,
-                    name_BPTYPE[((bit_elem_t*)(current->user_data))->type]);
-
-        current = current->next;
+        fail_debug("Element %d: %d bits, type %s", index_opcode + 1, bit_elem->width, name_BPTYPE[bit_elem->type]);
     }
 
     // Check if the format width is correct, and compute the ellipsis width
@@ -183,7 +183,11 @@ int command_format(data_t *id, linked_list_t *list)
         }
     }
 
-    hash_add(format_array, id->strVal, (void *)list);
+    // The widths are final, compute the layout once for every opcode of the format
+    bit_pattern_layout(pattern);
+    bit_pattern_index_mnemonic(pattern);
+
+    hash_add(format_array, id->strVal, (void *)pattern);
     return 0; // Success
 }
 
@@ -204,20 +208,10 @@ int command_order(data_t *id, linked_list_t *order_args)
         current = current->next;
     }
 
-    linked_list_t *start_bit_format_list = (linked_list_t *)hash_get(format_array, id->strVal);
-    linked_list_t *bit_format_list = start_bit_format_list;
-
-    // Count the number of arguments for the mnemonic
-    int n_args = 0;
-    while (bit_format_list != NULL)
-    {
-        if (((bit_elem_t *)(bit_format_list->user_data))->index_mnemonic >= 0)
-            n_args++;
-
-        bit_format_list = bit_format_list->next;
-    }
+    bit_pattern_t *pattern = (bit_pattern_t *)hash_get(format_array, id->strVal);
 
     // Check if we are reordering the correct number of arguments
+    int n_args = pattern->argument_count;
     if (n_reorder != n_args)
     {
         fail_error(
@@ -232,30 +226,21 @@ int command_order(data_t *id, linked_list_t *order_args)
     int index = 0;
     while (order_args != NULL)
     {
-        bit_format_list = start_bit_format_list;
-        while (bit_format_list != NULL)
+        int index_opcode = ((data_t *)(order_args->user_data))->iVal;
+        if (index_opcode < 0 || index_opcode >= pattern->count)
+            fail_error("Reordering out-of-range (index %i).", index_opcode);
+        else if (pattern->elems[index_opcode].index_mnemonic < 0)
         {
-            bit_elem_t *bit_elem = (bit_elem_t *)(bit_format_list->user_data);
-            if (bit_elem->index_opcode == ((data_t *)(order_args->user_data))->iVal)
-            {
-                if (bit_elem->index_mnemonic < 0)
-                {
-                    fail_error("Trying to reorder a non-argument (index %i).", bit_elem->index_opcode);
-                    return -1;
-                }
-                bit_elem->index_mnemonic = index;
-                n_args--;
-                break;
-            }
-
-            bit_format_list = bit_format_list->next;
+            fail_error("Trying to reorder a non-argument (index %i).", index_opcode);
+            return -1;
         }
-        if (bit_format_list == NULL)
-            fail_error("Reordering out-of-range (index %i).", ((data_t *)(order_args->user_data))->iVal);
+        else
+            pattern->elems[index_opcode].index_mnemonic = index;
         index++;
         order_args = order_args->next;
     }
 
+    bit_pattern_index_mnemonic(pattern);
     return 0;
 }
 
@@ -287,22 +272,11 @@ int command_opcode(data_t *id, data_t *pattern, data_t *opcode_id, bool is_const
         resolved_opcode_id = &(opcode_id->bVal);
 
     // Get the format
-    linked_list_t *format_list = (linked_list_t *)hash_get(format_array, id->strVal);
-    linked_list_t *current = format_list;
+    bit_pattern_t *format = (bit_pattern_t *)hash_get(format_array, id->strVal);
 
     // Check if the format expects an id
-    bit_elem_t *id_bit_elem = NULL;
-    bool require_id = false;
-    while (current != NULL)
-    {
-        if (((bit_elem_t *)(current->user_data))->type == eBP_ID)
-        {
-            id_bit_elem = (bit_elem_t *)(current->user_data);
-            require_id = true;
-            break;
-        }
-        current = current->next;
-    }
+    bool require_id = format->id_index >= 0;
+    bit_elem_t const *id_bit_elem = require_id ? &format->elems[format->id_index] : NULL;
 
     // Produce warning if the opcode ID is not the correct width
     if (opcode_id != NULL)
@@ -344,34 +318,11 @@ int command_opcode(data_t *id, data_t *pattern, data_t *opcode_id, bool is_const
     if (opcode_id != NULL && !require_id)
         fail_warning("'%s' does not expect an opcode id. Ignored.", id->strVal);
 
-    // Create a new opcode and clone the bitpattern
+    // Create a new opcode referencing the format, only its id is its own
     opcode_t new_opcode;
     new_opcode.text_pattern = pattern->strVal;
-    new_opcode.bit_pattern = NULL;
-    linked_list_t *list_element;
-    current = format_list;
-    while (current != NULL)
-    {
-        if (((bit_elem_t *)(current->user_data))->type == eBP_ID) // Replace the id
-        {
-            bit_elem_t *new_bit_elem = bit_elem_init(
-                eBP_BIT_LIT,
-                ((bit_elem_t *)(current->user_data))->width,
-                resolved_opcode_id);
-            new_bit_elem->index_mnemonic = -1;
-            new_bit_elem->index_opcode = ((bit_elem_t *)(current->user_data))->index_opcode;
-            list_element = list_init(eBP_BIT_LIT, (void *)new_bit_elem, current->data_type);
-        }
-        else
-            list_element = list_init(current->type, current->user_data, current->data_type);
-
-        if (new_opcode.bit_pattern == NULL)
-            new_opcode.bit_pattern = list_element;
-        else
-            list_append(new_opcode.bit_pattern, list_element);
-
-        current = current->next;
-    }
+    new_opcode.format = format;
+    new_opcode.id = require_id ? *resolved_opcode_id : (bit_const_t){0};
 
     darray_add(&opcode_array, new_opcode);
 
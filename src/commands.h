@@ -9,6 +9,8 @@
 #include "hash_array.h"
 
 
+typedef struct bit_pattern_s bit_pattern_t;
+
 typedef struct pattern_s
 {
     bit_const_t bit_const;
@@ -27,7 +29,8 @@ typedef struct
 {
     int token_id;
     char *text_pattern;
-    linked_list_t *bit_pattern;
+    bit_pattern_t const *format; // Shared by all the opcodes of the format
+    bit_const_t id;              // Value of the ID() substitution of the format, if it has one
 } opcode_t;
 
 typedef struct
@@ -0,0 +1,183 @@
+#include "decoder.h"
+
+#include <stdbool.h>
+
+#include "xmalloc.h"
+
+typedef struct
+{
+    decoder_t *decoder;
+    uint64_t const *masks;
+    uint64_t const *values;
+    uint64_t word_mask;
+} build_t;
+
+// Build the node at the given index for a set of patterns, knowing the bits already tested by its parents
+static void build_node(build_t *build, int node, int *set, int count, uint64_t tested);
+// Turn a node into a leaf trying a set of patterns
+static void build_leaf(build_t *build, int node, int *set, int count);
+// Find the longest run of set bits, keeping its most significant bits when it is wider than DECODER_MAX_BITS
+static void longest_run(uint64_t bits, int *shift, int *width);
+static int bit_count(uint64_t value);
+
+/*********************************************************************/
+
+decoder_t *decoder_build(int count, uint64_t const *masks, uint64_t const *values, int width)
+{
+    decoder_t *decoder = xmalloc(sizeof(decoder_t));
+    decoder->nodes = darray_init(sizeof(decoder_node_t));
+    decoder->candidates = darray_init(sizeof(int));
+
+    build_t build = {
+        .decoder = decoder,
+        .masks = masks,
+        .values = values,
+        .word_mask = width >= 64 ? 0xFFFFFFFFFFFFFFFFLLU : ~(0xFFFFFFFFFFFFFFFFLLU << width),
+    };
+
+    int set[count + 1];
+    for (int i = 0; i < count; i++)
+        set[i] = i;
+
+    decoder_node_t root = {0};
+    darray_add(&(decoder->nodes), root);
+    build_node(&build, 0, set, count, 0);
+    return decoder;
+}
+
+void decoder_destroy(decoder_t *decoder)
+{
+    if (decoder == NULL)
+        return;
+
+    darray_destroy(&(decoder->nodes));
+    darray_destroy(&(decoder->candidates));
+    free(decoder);
+}
+
+/*********************************************************************/
+
+static void build_node(build_t *build, int node, int *set, int count, uint64_t tested)
+{
+    uint64_t untested = build->word_mask & ~tested;
+    uint64_t common = untested;
+    uint64_t any = 0;
+    for (int i = 0; i < count; i++)
+    {
+        common &= build->masks[set[i]];
+        any |= build->masks[set[i]];
+    }
+    any &= untested;
+
+    // Nothing left to tell the patterns apart
+    if (count <= 1 || any == 0 || (common == 0 && count <= DECODER_LEAF_SIZE))
+    {
+        build_leaf(build, node, set, count);
+        return;
+    }
+
+    int shift = 0, width;
+    if (common != 0)
+    {
+        longest_run(common, &shift, &width);
+    }
+    else
+    {
+        // No bit is fixed by all the patterns, split them on the bit fixed by the most of them
+        int best = 0;
+        width = 1;
+        for (int bit = 0; bit < 64; bit++)
+        {
+            if (!(any & (1LLU << bit)))
+                continue;
+            int fixed = 0;
+            for (int i = 0; i < count; i++)
+                fixed += (build->masks[set[i]] >> bit) & 1;
+            if (fixed > best)
+            {
+                best = fixed;
+                shift = bit;
+            }
+        }
+    }
+
+    // The children are contiguous, indexed by the value of the field
+    int children = 1 << width;
+    int first = build->decoder->nodes->count;
+    decoder_node_t child = {0};
+    for (int i = 0; i < children; i++)
+        darray_add(&(build->decoder->nodes), child);
+    darray_at(&(build->decoder->nodes), decoder_node_t, node) = (decoder_node_t){.shift = shift, .width = width, .first = first};
+
+    uint64_t field = ~(0xFFFFFFFFFFFFFFFFLLU << width) << shift;
+    int subset[count + 1];
+    for (int value = 0; value < children; value++)
+    {
+        // A pattern not fixing a bit of the field matches both of its values
+        int subset_count = 0;
+        for (int i = 0; i < count; i++)
+        {
+            uint64_t mask = build->masks[set[i]] & field;
+            if ((build->values[set[i]] & mask) == (((uint64_t)value << shift) & mask))
+                subset[subset_count++] = set[i];
+        }
+        build_node(build, first + value, subset, subset_count, tested | field);
+    }
+}
+
+static void build_leaf(build_t *build, int node, int *set, int count)
+{
+    // Insertion sort, the most fixed bits first then in the order of the patterns
+    for (int i = 1; i < count; i++)
+    {
+        int pattern = set[i];
+        int bits = bit_count(build->masks[pattern]);
+        int j = i;
+        while (j > 0 && (bit_count(build->masks[set[j - 1]]) < bits ||
+                         (bit_count(build->masks[set[j - 1]]) == bits && set[j - 1] > pattern)))
+        {
+            set[j] = set[j - 1];
+            j--;
+        }
+        set[j] = pattern;
+    }
+
+    int first = build->decoder->candidates->count;
+    if (count > 0)
+        darray_append_n(&(build->decoder->candidates), set, count);
+    darray_at(&(build->decoder->nodes), decoder_node_t, node) = (decoder_node_t){.shift = -1, .first = first, .count = count};
+}
+
+static void longest_run(uint64_t bits, int *shift, int *width)
+{
+    *shift = 0;
+    *width = 0;
+    int start = 0;
+    for (int bit = 0; bit <= 64; bit++)
+    {
+        if (bit < 64 && (bits & (1LLU << bit)))
+            continue;
+
+        // The run ends before this bit
+        if (bit - start > *width)
+        {
+            *width = bit - start;
+            *shift = start;
+        }
+        start = bit + 1;
+    }
+
+    if (*width > DECODER_MAX_BITS)
+    {
+        *shift += *width - DECODER_MAX_BITS;
+        *width = DECODER_MAX_BITS;
+    }
+}
+
+static int bit_count(uint64_t value)
+{
+    int count = 0;
+    for (; value != 0; value &= value - 1)
+        count++;
+    return count;
+}
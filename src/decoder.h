@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "dynamic_array.h"
+
+// Widest field tested by a node, a node has up to 2^DECODER_MAX_BITS children
+#define DECODER_MAX_BITS 8
+// Largest set of patterns left to a linear search once no bit is fixed by all of them
+#define DECODER_LEAF_SIZE 4
+
+typedef struct
+{
+    int shift; // Lowest bit of the field tested by the node, -1 for a leaf
+    int width; // Width of the tested field, 0 for a leaf
+    int first; // First child in the nodes, or first candidate of a leaf
+    int count; // Number of candidates of a leaf
+} decoder_node_t;
+
+typedef struct
+{
+    darray_t *nodes;      // decoder_node_t, the root first and the children of a node contiguous
+    darray_t *candidates; // int, index of the patterns tried by each leaf, the most specific first
+} decoder_t;
+
+/**
+ * @brief Build a decision tree finding the patterns a word can match by testing its fixed bits
+ *
+ * @details Each node tests a field of bits, fixed by all its remaining patterns when possible. A pattern not fixing
+ * some bits of the field is a candidate of every child. A leaf lists the patterns left, which still have to be
+ * compared to the word, from the most fixed bits to the least
+ *
+ * @param count Number of patterns
+ * @param masks Bits fixed by each pattern
+ * @param values Value of the fixed bits of each pattern
+ * @param width Number of bits of a word
+ * @return decoder_t* The decision tree
+ */
+decoder_t *decoder_build(int count, uint64_t const *masks, uint64_t const *values, int width);
+
+/**
+ * @brief Free a decision tree
+ *
+ * @param decoder The decision tree, invalid after the call
+ */
+void decoder_destroy(decoder_t *decoder);
@@ -1,22 +1,50 @@
 #include "dynamic_array.h"
 
+#include "arena.h"
+
 #define DEFAULT_DARRAY_SIZE 16
 
 void _darray_add(darray_t **array, const void const *data);
 
+// Move the array to a block large enough for size elements. The arrays of an arena are copied
+//  to a new block when they grow, and keep their block when they shrink
+static darray_t *darray_reallocate(darray_t *array, size_t size)
+{
+    if (array->arena == NULL)
+        return realloc(array, sizeof(darray_t) + array->element_size * size);
+
+    if (size <= array->size)
+        return array;
+
+    darray_t *new_array = arena_alloc(array->arena, sizeof(darray_t) + array->element_size * size);
+    memcpy(new_array, array, sizeof(darray_t) + array->element_size * array->count);
+    return new_array;
+}
+
 darray_t *darray_init(size_t element_size)
+{
+    return darray_init_size(element_size, DEFAULT_DARRAY_SIZE);
+}
+
+darray_t *darray_init_size(size_t element_size, size_t size)
 {
     if (element_size == 0)
     {
         fputs(STR(__FILE__) ":" STR(__LINE__) "  Trying to allocate dynamic array with an element size of 0\n", stderr);
         abort();
     }
+    size = size > 0 ? size : 1;
 
     darray_t *new_darray;
-    new_darray = malloc(sizeof(darray_t) + element_size * DEFAULT_DARRAY_SIZE);
+    arena_t *arena = arena_current();
+    if (arena != NULL)
+        new_darray = arena_alloc(arena, sizeof(darray_t) + element_size * size);
+    else
+        new_darray = malloc(sizeof(darray_t) + element_size * size);
     new_darray->element_size = element_size;
     new_darray->count = 0;
-    new_darray->size = DEFAULT_DARRAY_SIZE;
+    new_darray->size = size;
+    new_darray->arena = arena;
 
     return new_darray;
 }
@@ -25,7 +53,7 @@ void _darray_add(darray_t **array, const void const *data)
 {
     if ((*array)->count >= (*array)->size)
     {
-        (*array) = realloc((*array), sizeof(darray_t) + ((*array)->element_size) * ((*array)->size) * 2);
+        (*array) = darray_reallocate(*array, (*array)->size * 2);
         (*array)->size *= 2;
     }
 
@@ -33,15 +61,18 @@ void _darray_add(darray_t **array, const void const *data)
     (*array)->count++;
 }
 
+void darray_append_n(darray_t **array, const void *data, size_t count)
+{
+    darray_reserve(array, (*array)->count + count);
+    memcpy((*array)->element_list + ((*array)->element_size * (*array)->count), data, (*array)->element_size * count);
+    (*array)->count += count;
+}
+
 void darray_get(darray_t **array, void *data, int index)
 {
     size_t computed_index = index * (*array)->element_size;
 
-    // Copy all bytes to the array
-    for (int i = 0; i < (*array)->element_size; i++)
-    {
-        *((uint8_t *)data + i) = (*array)->element_list[computed_index + i];
-    }
+    memcpy(data, (*array)->element_list + computed_index, (*array)->element_size);
 }
 
 void *darray_get_ptr(darray_t **array, int index)
@@ -60,7 +91,7 @@ void darray_copy(darray_t **array_dest, darray_t **array_src)
 
 void darray_resize(darray_t **array, int size)
 {
-    *array = realloc(*array, sizeof(darray_t) + size * (*array)->element_size);
+    *array = darray_reallocate(*array, size);
     (*array)->size = size;
     (*array)->count = ((*array)->count > (*array)->size) ? (*array)->size : (*array)->count;
 }
@@ -71,7 +102,7 @@ void darray_remove(darray_t **array, int count)
 
     if ((*array)->count <= (*array)->size / 2 && (*array)->count >= DEFAULT_DARRAY_SIZE)
     {
-        (*array) = realloc((*array), sizeof(darray_t) + ((*array)->element_size) * ((*array)->size) / 2);
+        (*array) = darray_reallocate(*array, (*array)->size / 2);
         (*array)->size /= 2;
     }
 }
@@ -99,9 +130,32 @@ void darray_empty(darray_t **array)
     (*array)->count = 0;
 }
 
-// Deallocate the array
-void darray_free(darray_t **array)
+void darray_reserve(darray_t **array, size_t size)
+{
+    if (size <= (*array)->size)
+        return;
+
+    // Grow geometrically, so a sequence of reservations stays linear
+    size_t new_size = (*array)->size * 2;
+    darray_resize(array, new_size > size ? new_size : size);
+}
+
+void darray_clear(darray_t **array)
+{
+    (*array)->count = 0;
+}
+
+void darray_shrink_to_fit(darray_t **array)
+{
+    size_t size = (*array)->count > DEFAULT_DARRAY_SIZE ? (*array)->count : DEFAULT_DARRAY_SIZE;
+    if (size < (*array)->size)
+        darray_resize(array, size);
+}
+
+void darray_destroy(darray_t **array)
 {
-    free(*array);
+    // The arrays of an arena are freed with it
+    if (*array != NULL && (*array)->arena == NULL)
+        free(*array);
     *array = NULL;
 }
\ No newline at end of file
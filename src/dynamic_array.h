@@ -12,17 +12,28 @@ typedef struct
     size_t element_size;
     size_t size;
     size_t count;
+    struct arena_s *arena;  // Arena the array is allocated from, NULL for the heap
     uint8_t element_list[]; // Byte array
 } darray_t;
 
 /**
  * @brief Initialise a dynamic array with a specific element size
+ * @details The array is allocated from the arena entered on the calling thread, if any
  *
  * @param element_size The size in bytes of an element (sizeof(TYPE))
  * @return darray_t* The newly created empty dynamic array
  */
 darray_t *darray_init(size_t element_size);
 
+/**
+ * @brief Initialise a dynamic array with room for a number of elements
+ *
+ * @param element_size The size in bytes of an element (sizeof(TYPE))
+ * @param size Number of elements it can hold before growing, at least 1
+ * @return darray_t* The newly created empty dynamic array
+ */
+darray_t *darray_init_size(size_t element_size, size_t size);
+
 // Wrapped function
 void _darray_add(darray_t **array, const void const *data);
 /**
@@ -36,6 +47,15 @@ void _darray_add(darray_t **array, const void const *data);
  */
 #define darray_add(array, data) _darray_add((array), (&(data)))
 
+/**
+ * @brief Add several elements to the array, growing it at most once
+ *
+ * @param array A pointer to the array to modify
+ * @param data The elements, contiguous
+ * @param count The number of elements
+ */
+void darray_append_n(darray_t **array, const void *data, size_t count);
+
 /**
  * @brief Remove n elements from the end
  *
@@ -60,6 +80,16 @@ void darray_remove(darray_t **array, int count);
  */
 void darray_remove_at(darray_t **array, int count, int index);
 
+/**
+ * @def darray_at(array, type, index)
+ * @brief Access an element in place, without bound checking
+ *
+ * @param array A pointer to the dynamic array
+ * @param type The type of the elements
+ * @param index The index of the element
+ */
+#define darray_at(array, type, index) (((type *)((*(array))->element_list))[(index)])
+
 /**
  * @brief Get the data at a specific index and store the result
  *
@@ -101,4 +131,33 @@ void darray_resize(darray_t **array, int size);
  * resize it to the default size
  *
  */
-void darray_empty(darray_t **array);
\ No newline at end of file
+void darray_empty(darray_t **array);
+
+/**
+ * @brief Make room for at least a number of elements, so as many additions never reallocate
+ *
+ * @param array Pointer to the array
+ * @param size Size in number of elements, nothing is done if the array is already as large
+ */
+void darray_reserve(darray_t **array, size_t size);
+
+/**
+ * @brief Remove all elements of the array, keeping its allocated memory
+ *
+ * @param array Pointer to the array
+ */
+void darray_clear(darray_t **array);
+
+/**
+ * @brief Release the memory allocated beyond the elements of the array
+ *
+ * @param array Pointer to the array
+ */
+void darray_shrink_to_fit(darray_t **array);
+
+/**
+ * @brief Free the array. The elements themselves are not freed, the arrays of an arena are freed with it
+ *
+ * @param array Pointer to the array, set to NULL
+ */
+void darray_destroy(darray_t **array);
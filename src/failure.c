@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 
 #define RESET_COLOUR 0
 #define DETA_COLOUR 0
@@ -28,21 +29,21 @@ static int showColour = 1;
 static int verbositiy = 2;
 
 // Encaplsulated to have a more realiable error system
-static int info_count = 0;
+static atomic_int info_count = 0;
 int fail_get_info_count()
 {
     return info_count;
 }
 
 // Encaplsulated to have a more realiable error system
-static int warning_count = 0;
+static atomic_int warning_count = 0;
 int fail_get_warning_count()
 {
     return warning_count;
 }
 
 // Encaplsulated to have a more realiable error system
-static int error_count = 0; // Quite useless if we exit directly after an error
+static atomic_int error_count = 0; // Quite useless if we exit directly after an error
 int fail_get_error_count()
 {
     return error_count;
@@ -88,6 +89,7 @@ void fail_debug(const char *format, ...)
 
     va_list args;
     va_start(args, format);
+    flockfile(stderr);
     set_colour(DETA_COLOUR);
 
     if (showLoc)
@@ -98,6 +100,7 @@ void fail_debug(const char *format, ...)
     vfprintf(stderr, format, args);
     set_colour(RESET_COLOUR);
     fputc('\n', stderr);
+    funlockfile(stderr);
     va_end(args);
 }
 
@@ -110,6 +113,7 @@ void fail_info(const char *format, ...)
 
     va_list args;
     va_start(args, format);
+    flockfile(stderr);
     set_colour(INFO_COLOUR);
 
     if (showLoc)
@@ -119,6 +123,7 @@ void fail_info(const char *format, ...)
     vfprintf(stderr, format, args);
     set_colour(RESET_COLOUR);
     fputc('\n', stderr);
+    funlockfile(stderr);
     va_end(args);
 }
 
@@ -131,6 +136,7 @@ void fail_warning(const char *format, ...)
 
     va_list args;
     va_start(args, format);
+    flockfile(stderr);
     set_colour(WARN_COLOUR);
 
     if (showLoc)
@@ -141,6 +147,7 @@ void fail_warning(const char *format, ...)
     vfprintf(stderr, format, args);
     set_colour(RESET_COLOUR);
     fputc('\n', stderr);
+    funlockfile(stderr);
     va_end(args);
 }
 
@@ -154,6 +161,7 @@ void fail_error(const char *format, ...)
 
     va_list args;
     va_start(args, format);
+    flockfile(stderr);
     set_colour(ERRO_COLOUR);
 
     if (showLoc)
@@ -164,6 +172,7 @@ void fail_error(const char *format, ...)
     vfprintf(stderr, format, args);
     set_colour(RESET_COLOUR);
     fputc('\n', stderr);
+    funlockfile(stderr);
     va_end(args);
     // exit(EXIT_FAILURE);
 }
@@ -1,17 +1,37 @@
 #include "generator.h"
 #include "failure.h"
+#include "stats.h"
+#include "cache.h"
+#include "profile.h"
+#include "decoder.h"
 
 /*********************************************************************/
 
+// Operand field of an opcode, as described in the encoding tables
+typedef struct
+{
+    char const *kind;
+    int operand;
+    int offset;
+    int width;
+} field_desc_t;
+
 static FILE *fd = NULL;
+static string_builder_t *output = NULL; // Everything is emitted in memory, then written at once
+static size_t flushed_size = 0;         // Bytes written by generator_flush, for the statistics
+static char const *library_header = NULL;
+static bool encoder_tables = true;
+static bool split = false;
 
 static state_machine_t *lexer_dfa;
 static const token_def_t *tokens_array;
 static int token_count;
+static bool *token_first; // First token of each id, the others share its action
 
 static state_machine_t *parser_dfa;
 static const rule_def_t **rules;
 static int rule_count;
+static bool *rule_first; // First rule of each id, the others are merged with it
 
 /**
  * @brief print with an indentation level
@@ -32,13 +52,50 @@ void iprintf(size_t indentation, const char *format, ...);
 void generator_dfa_switch(int indent, state_machine_t *state_machine, char *name);
 
 /**
- * @brief Print to a dynamic array
+ * @brief Compute the length of the longest path from the start state of a state machine
+ *
+ * @param state_machine The state machine
+ * @return int The number of transitions of the longest path, -1 if it is unbounded
+ */
+int generator_longest_path(state_machine_t *state_machine);
+
+/**
+ * @brief Compute the number of tokens of the longest rule, a set counting as a single token
+ *
+ * @return int The number of tokens
+ */
+int generator_longest_rule();
+
+/**
+ * @brief Print a line to a string builder
  *
- * @param array Pointer to the dynamic array
+ * @param builder The string builder
  * @param format printf-like format string
  * @param ... Arguments
  */
-void bprintf(darray_t **array, const char *format, ...);
+void bprintf(string_builder_t *builder, const char *format, ...);
+
+// Mark the first occurrence of each id, using a hash set of the ids already seen
+static bool *first_occurrences(int const *ids, int count);
+
+// Go to the next state of a transition, counted at a profile site in the profiling builds
+static void dfa_transition(int indent, state_machine_t *state_machine, char const *name, int next_state_id, int site);
+// Profile sites of a state: one per different next state, in the order of the transitions, then the exit and the
+// invalid token. Store the site of each transition in sites when not NULL, and return the number of next states
+static int transition_sites(state_t *state, int *sites);
+// Next state of a site of a state, from the sites of its transitions
+static int target_of_site(state_t *state, int const *sites, int site);
+// Indexes of the states of a state machine, the most visited in the loaded profile first when it is profiled
+static size_t *hot_order(state_machine_t *state_machine, char const *name, bool profiled);
+// Hash of the states and transitions of a state machine, which the ids of the profile sites refer to
+static uint64_t machine_fingerprint(state_machine_t *state_machine);
+// Declare the counters of the profile sites of a state machine, when the assembler is built with ASS_PROFILE
+static void profile_table(int indent, state_machine_t *state_machine, char const *name);
+
+// Emit a string as a C string literal
+static void c_string(char const *str);
+// Get the operands of a format, in the order of the mnemonic, as described in the disassembly tables
+static int format_operands(bit_pattern_t const *format, field_desc_t *operands, enumeration_t const **enumerations);
 
 // Handle an xmalloc error
 static void xmalloc_callback(int err);
@@ -48,66 +105,191 @@ static void xmalloc_callback(int err);
 void generator_set_file_descriptor(FILE *file_descriptor)
 {
     fd = file_descriptor;
+    if (output == NULL)
+        output = sbuilder_init();
+}
+
+void generator_emit(char const *text, size_t length)
+{
+    sbuilder_append(output, text, length);
+}
+
+bool generator_flush(void)
+{
+    flushed_size += output->length;
+    return sbuilder_flush(output, fd);
+}
+
+size_t generator_flushed_size(void)
+{
+    return flushed_size;
+}
+
+void generator_set_library_header(char const *header_name)
+{
+    library_header = header_name;
+}
+
+void generator_set_encoder_tables(bool tables)
+{
+    encoder_tables = tables;
+}
+
+void generator_set_split(bool split_units)
+{
+    split = split_units;
+}
+
+bool generator_split_user_code(void)
+{
+    return split && (code == NULL || code[0] == '\0');
 }
 
 void generator_generate_lexer(int count, const token_def_t *_tokens)
 {
     token_count = count;
     tokens_array = _tokens;
+
+    int *ids = xmalloc(sizeof(int) * (count + 1));
+    for (int i = 0; i < count; i++)
+        ids[i] = _tokens[i].id;
+    token_first = first_occurrences(ids, count);
+    free(ids);
     xmalloc_set_handler(xmalloc_callback);
     lexer_dfa = xmalloc(sizeof(state_machine_t));
-    state_machine_t nfa = tokeniser_array_to_nfa(count, _tokens);
-    state_machine_reduce(&nfa);
-    *lexer_dfa = state_machine_make_deterministic(&nfa);
+
+    // The DFA only depends on the ids and the patterns of the tokens
+    uint64_t key = cache_hash_string(cache_hash_version(CACHE_HASH_INIT), "lexer");
+    for (int i = 0; i < count; i++)
+    {
+        key = cache_hash(key, &(_tokens[i].id), sizeof(_tokens[i].id));
+        key = cache_hash_string(key, _tokens[i].pattern);
+    }
+    if (cache_load_machine("lexer", key, lexer_dfa))
+    {
+        stats_machine("lexer DFA cached", lexer_dfa);
+        return;
+    }
+
+    // The literal tokens are built directly as a trie, the subset construction only handles the others
+    stats_begin("lexer literal trie");
+    *lexer_dfa = tokeniser_literals_to_dfa(count, _tokens);
+    stats_end();
+    stats_machine("lexer literal trie", lexer_dfa);
+
+    token_def_t *patterns = xmalloc(sizeof(token_def_t) * (count + 1));
+    int pattern_count = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (!tokeniser_is_literal(_tokens[i]))
+            patterns[pattern_count++] = _tokens[i];
+    }
+
+    if (pattern_count > 0)
+    {
+        stats_begin("lexer NFA build");
+        state_machine_t nfa = tokeniser_array_to_nfa(pattern_count, patterns);
+        stats_end();
+        stats_machine("lexer NFA", &nfa);
+
+        stats_begin("lexer NFA state_machine_reduce");
+        state_machine_reduce(&nfa);
+        stats_end();
+        stats_machine("lexer NFA reduced", &nfa);
+
+        stats_begin("lexer state_machine_make_deterministic");
+        state_machine_t pattern_dfa = state_machine_make_deterministic(&nfa);
+        state_machine_destroy(&nfa);
+        stats_end();
+        stats_machine("lexer patterns DFA", &pattern_dfa);
+
+        stats_begin("lexer state_machine_product");
+        state_machine_t trie = *lexer_dfa;
+        *lexer_dfa = state_machine_product(&trie, &pattern_dfa);
+        state_machine_destroy(&trie);
+        state_machine_destroy(&pattern_dfa);
+        stats_end();
+        stats_machine("lexer DFA", lexer_dfa);
+    }
+    free(patterns);
+
+    stats_begin("lexer DFA state_machine_reduce");
     state_machine_reduce(lexer_dfa);
-    // state_machine_destroy(&nfa);
+    stats_end();
+    stats_machine("lexer DFA reduced", lexer_dfa);
+    state_machine_compact(lexer_dfa);
+    cache_store_machine("lexer", key, lexer_dfa);
 }
 
 void generator_generate_parser(int count, const rule_def_t **_rules)
 {
     rule_count = count;
     rules = _rules;
+
+    int *ids = xmalloc(sizeof(int) * (count + 1));
+    for (int i = 0; i < count; i++)
+        ids[i] = _rules[i]->id;
+    rule_first = first_occurrences(ids, count);
+    free(ids);
     xmalloc_set_handler(xmalloc_callback);
     parser_dfa = xmalloc(sizeof(state_machine_t));
+
+    // The DFA only depends on the ids and the token sequences of the rules
+    uint64_t key = cache_hash_string(cache_hash_version(CACHE_HASH_INIT), "parser");
+    for (int i = 0; i < count; i++)
+    {
+        key = cache_hash(key, &(_rules[i]->id), sizeof(_rules[i]->id));
+        key = cache_hash(key, &(_rules[i]->count), sizeof(_rules[i]->count));
+        key = cache_hash(key, _rules[i]->tokens, sizeof(int) * _rules[i]->count);
+    }
+    if (cache_load_machine("parser", key, parser_dfa))
+    {
+        stats_machine("parser DFA cached", parser_dfa);
+        return;
+    }
+
+    stats_begin("parser NFA build");
     state_machine_t nfa = parser_arrays_to_nfa(count, _rules);
+    stats_end();
+    stats_machine("parser NFA", &nfa);
+
+    stats_begin("parser NFA state_machine_reduce");
     state_machine_reduce(&nfa);
+    stats_end();
+    stats_machine("parser NFA reduced", &nfa);
+
+    stats_begin("parser state_machine_make_deterministic");
     *parser_dfa = state_machine_make_deterministic(&nfa);
-    state_machine_reduce(parser_dfa);
+    state_machine_destroy(&nfa);
+    stats_end();
+    stats_machine("parser DFA", parser_dfa);
 
-    // state_machine_destroy(&nfa);
+    stats_begin("parser DFA state_machine_reduce");
+    state_machine_reduce(parser_dfa);
+    stats_end();
+    stats_machine("parser DFA reduced", parser_dfa);
+    state_machine_compact(parser_dfa);
+    cache_store_machine("parser", key, parser_dfa);
 }
 
 char *generator_generate_pattern_action(pattern_t *pattern)
 {
-    darray_t **buff = alloca(sizeof(sizeof(darray_t *)));
-    *buff = darray_init(1);
+    string_builder_t *buff = sbuilder_init();
 
-    // Because of the way "darray_add" is implemented, we can't pass it rvalues
-    char tmp = '\0';
-    darray_add(buff, tmp); // Start the buffer as an empty string
-
-    // TODO: free the dynamic array. Make "darray_destroy" first
     bprintf(buff, "    ASS_data_t data;");
     bprintf(buff, "    data.type = ASS_DT_SIGNED;");
     bprintf(buff, "    data.iVal = 0x%X;", pattern->bit_const.val);
     bprintf(buff, "    return data;");
-    xmalloc_set_handler(xmalloc_callback);
-    char *result = xmalloc((*buff)->count);
-    strcpy(result, (char *)((*buff)->element_list));
+
+    return sbuilder_release(buff);
 }
 
 char *generator_generate_opcode_action(opcode_t opcode)
 {
-    uint32_t offset = 0;
-    darray_t **buff = alloca(sizeof(sizeof(darray_t *)));
-    *buff = darray_init(1);
+    string_builder_t *buff = sbuilder_init();
 
     fail_debug("Generating opcode action for opcode \"%s\"", opcode.text_pattern);
 
-    // Because of the way "darray_add" is implemented, we can't pass it rvalues
-    char tmp = '\0';
-    darray_add(buff, tmp); // Start the buffer as an empty string
-
     bprintf(buff, "    ASS_opcode_t opcode =");
     bprintf(buff, "    {");
     bprintf(buff, "        .address = ASS_current_address,");
@@ -116,103 +298,71 @@ char *generator_generate_opcode_action(opcode_t opcode)
     bprintf(buff, "");
     bprintf(buff, "    uint64_t data = 0;");
     bprintf(buff, "    uint64_t mask = 0;");
-    bprintf(buff, "    ASS_ref_t new_ref;");
     bprintf(buff, "");
 
-    // Process each element in the opcode reverse order
-    //  doing it in reverse allow use to keep track of the
-    //  offset
-    int len = list_get_lenght(opcode.bit_pattern);
-    for (int i = len - 1; i >= 0; i--)
+    // Process each element in the opcode reverse order, from the least significant one
+    //  the offsets and the masks have been computed with the format
+    bit_pattern_t const *format = opcode.format;
+    for (int i = format->count - 1; i >= 0; i--)
     {
-        linked_list_t *current = opcode.bit_pattern;
-        while (current != NULL)
-        {
-            bit_elem_t *bit_elem = (bit_elem_t *)(current->user_data);
-
-            if (bit_elem->index_opcode == i)
-            {
-                //Compute the bit mask
-                uint64_t mask = (0xFFFFFFFFFFFFFFFFLLU << offset);
-                mask &= ~(0xFFFFFFFFFFFFFFFFLLU << (offset + bit_elem->width));
+        bit_elem_t const *bit_elem = &format->elems[i];
+        uint32_t offset = bit_elem->offset;
+        uint64_t mask = bit_elem->mask;
 
-                //Compute the value (for literals)
-                uint64_t val = (((bit_const_t *)(bit_elem->data))->val << offset) & mask;
+        //Compute the value (for literals, the id is the one of the opcode)
+        bit_const_t const *constant = bit_elem->type == eBP_ID ? &opcode.id : &bit_elem->bit_const;
+        uint64_t val = (constant->val << offset) & mask;
 
-                switch (bit_elem->type)
-                {
-                case eBP_IMMEDIATE:
-                    bprintf(buff, "    /**eBP_IMMEDIATE**/");
-                    bprintf(buff, "    if (ASS_parser_stack[%i].type == ASS_DT_STRING)", bit_elem->index_mnemonic);
-                    bprintf(buff, "        data = ASS_resolve_const(ASS_parser_stack[%i].sVal);", bit_elem->index_mnemonic);
-                    bprintf(buff, "    else");
-                    bprintf(buff, "        data = ASS_parser_stack[%i].iVal;", bit_elem->index_mnemonic);
-                    //bprintf(buff, "    opcode.data &= 0x%llXLLU;", ~mask);
-                    bprintf(buff, "    opcode.data |= (0x%llXLLU & (data << %u));", mask, offset);
-                    break;
-                case eBP_LABEL_ABS:
-                    bprintf(buff, "    /**eBP_LABEL_ABS**/");
-                    bprintf(buff, "    new_ref.absolute = true;");
-                    bprintf(buff, "    new_ref.symbol_name = ASS_parser_stack[%i].sVal;", bit_elem->index_mnemonic);
-                    bprintf(buff, "    new_ref.index = ASS_binary_stack_ptr;");
-                    bprintf(buff, "    new_ref.bit_offset = %i;", offset);
-                    bprintf(buff, "    new_ref.bit_width = %i;", bit_elem->width);
-                    bprintf(buff, "    ASS_ref_stack_push(new_ref);");
-                    break;
-                case eBP_LABEL_REL:
-                    bprintf(buff, "    /**eBP_LABEL_REL**/");
-                    bprintf(buff, "    new_ref.absolute = false;");
-                    bprintf(buff, "    new_ref.symbol_name = ASS_parser_stack[%i].sVal;", bit_elem->index_mnemonic);
-                    bprintf(buff, "    new_ref.index =  ASS_binary_stack_ptr;");
-                    bprintf(buff, "    new_ref.bit_offset = %i;", offset);
-                    bprintf(buff, "    new_ref.bit_width = %i;", bit_elem->width);
-                    bprintf(buff, "    ASS_ref_stack_push(new_ref);");
-                case eBP_ENUM:
-                    bprintf(buff, "    /**eBP_ENUM**/");
-                    bprintf(buff, "    data = ASS_parser_stack[%i].iVal;", bit_elem->index_mnemonic);
-                    //bprintf(buff, "    opcode.data &= 0x%llXLLU;", ~mask);
-                    bprintf(buff, "    opcode.data |= (0x%llXLLU & (data << %u));", mask, offset);
-                    break;
-                case eBP_ID:
-                    fprintf(stderr, "Unresolved ID\n");
-                    abort();
-                    break;
-                case eBP_BIT_CONST:
-                case eBP_BIT_LIT:
-                    bprintf(buff, "    /**eBP_BIT_LIT**/");
-                    //bprintf(buff, "    opcode.data &= 0x%llXLLU;", ~mask);
-                    bprintf(buff, "    opcode.data |= (0x%llXLLU);", val);
-                    break;
-                case eBP_ELLIPSIS:
-                    bprintf(buff, "    /**eBP_ELLIPSIS**/");
-                    //bprintf(buff, "    opcode.data &= 0x%llXLLU;", ~mask);
-                    break;
-                default:
-                    fail_error("Unknown bit pattern type");
-                    exit(EXIT_FAILURE);
-                    break;
-                }
-
-                fail_debug("Element %i (%s) offset %u width %u", i, name_BPTYPE[bit_elem->type], offset, bit_elem->width);
-
-                // Keep track of the offset
-                offset += bit_elem->width;
-                break;
-            }
-
-            current = current->next;
+        switch (bit_elem->type)
+        {
+        case eBP_IMMEDIATE:
+            bprintf(buff, "    /**eBP_IMMEDIATE**/");
+            bprintf(buff, "    if (ASS_parser_stack[%i].type == ASS_DT_STRING)", bit_elem->index_mnemonic);
+            bprintf(buff, "        data = ASS_resolve_const(ASS_parser_stack[%i].sVal);", bit_elem->index_mnemonic);
+            bprintf(buff, "    else");
+            bprintf(buff, "        data = ASS_parser_stack[%i].iVal;", bit_elem->index_mnemonic);
+            //bprintf(buff, "    opcode.data &= 0x%llXLLU;", ~mask);
+            bprintf(buff, "    opcode.data |= (0x%llXLLU & (data << %u));", mask, offset);
+            break;
+        case eBP_LABEL_ABS:
+            bprintf(buff, "    /**eBP_LABEL_ABS**/");
+            bprintf(buff, "    ASS_reference_label(&opcode, ASS_parser_stack[%i].sVal, true, %i, %i);", bit_elem->index_mnemonic, offset, bit_elem->width);
+            break;
+        case eBP_LABEL_REL:
+            bprintf(buff, "    /**eBP_LABEL_REL**/");
+            bprintf(buff, "    ASS_reference_label(&opcode, ASS_parser_stack[%i].sVal, false, %i, %i);", bit_elem->index_mnemonic, offset, bit_elem->width);
+            break;
+        case eBP_ENUM:
+            bprintf(buff, "    /**eBP_ENUM**/");
+            bprintf(buff, "    data = ASS_parser_stack[%i].iVal;", bit_elem->index_mnemonic);
+            //bprintf(buff, "    opcode.data &= 0x%llXLLU;", ~mask);
+            bprintf(buff, "    opcode.data |= (0x%llXLLU & (data << %u));", mask, offset);
+            break;
+        case eBP_ID:
+        case eBP_BIT_CONST:
+        case eBP_BIT_LIT:
+            bprintf(buff, "    /**eBP_BIT_LIT**/");
+            //bprintf(buff, "    opcode.data &= 0x%llXLLU;", ~mask);
+            bprintf(buff, "    opcode.data |= (0x%llXLLU);", val);
+            break;
+        case eBP_ELLIPSIS:
+            bprintf(buff, "    /**eBP_ELLIPSIS**/");
+            //bprintf(buff, "    opcode.data &= 0x%llXLLU;", ~mask);
+            break;
+        default:
+            fail_error("Unknown bit pattern type");
+            exit(EXIT_FAILURE);
+            break;
         }
+
+        fail_debug("Element %i (%s) offset %u width %u", i, name_BPTYPE[bit_elem->type], offset, bit_elem->width);
     }
 
-    // TODO: free the dynamic array. Make "darray_destroy" first
     bprintf(buff, "");
     bprintf(buff, "    ASS_binary_stack_push(opcode);");
     bprintf(buff, "    ASS_current_address++;");
-    xmalloc_set_handler(xmalloc_callback);
-    char *result = xmalloc((*buff)->count);
-    strcpy(result, (char *)((*buff)->element_list));
 
-    return result;
+    return sbuilder_release(buff);
 }
 
 /**************************************************/
@@ -242,10 +392,8 @@ void generator_custom_outputs_selection(int indent)
     custom_output_t *array = darray_get_ptr(&custom_output_array, 0);
     for (int i = 0; i < custom_output_array->count; i++)
     {
-        iprintf(0 + indent, "else if (strcmp(argv[i], \"%s\") == 0)", array[i].name);
-        iprintf(0 + indent, "{");
-        iprintf(0 + indent, "    output_format = ASS_OUT_%s;", array[i].name);
-        iprintf(0 + indent, "}");
+        iprintf(0 + indent, "else if (strcmp(name, \"%s\") == 0)", array[i].name);
+        iprintf(1 + indent, "return ASS_OUT_%s;", array[i].name);
     }
 }
 
@@ -286,6 +434,13 @@ void generator_custom_outputs_function(int indent)
     custom_output_t *array = darray_get_ptr(&custom_output_array, 0);
     for (int i = 0; i < custom_output_array->count; i++)
     {
+        // Only declare the outputs when they have their own translation unit
+        if (generator_split_user_code())
+        {
+            iprintf(0 + indent, "void ASS_output_%s(FILE* fd);", array[i].name);
+            continue;
+        }
+
         iprintf(0 + indent, "void ASS_output_%s(FILE* fd)", array[i].name);
         iprintf(0 + indent, "{");
         iprintf(1 + indent, "%s", array[i].code);
@@ -310,7 +465,7 @@ void generator_startup(int indent)
 
 void generator_custom_code(int indent)
 {
-    iprintf(0, code);
+    iprintf(0, "%s", code == NULL ? "" : code);
 }
 
 void generator_help_message(int indent)
@@ -326,6 +481,13 @@ void generator_help_message(int indent)
     iprintf(1 + indent, "\"  -v           verbose\\n\"");
     iprintf(1 + indent, "\"  -c           disable coloured messages\\n\"");
     iprintf(1 + indent, "\"  -f <FORMAT>  set the format for the output file\\n\"");
+    iprintf(1 + indent, "\"  -j <N>       run the batch jobs on N worker processes\\n\"");
+    iprintf(1 + indent, "\"  --batch <FILE>  assemble all the jobs listed in the manifest FILE\\n\"");
+    iprintf(1 + indent, "\"  --watch      assemble again every time an input file changes\\n\"");
+    iprintf(1 + indent, "\"  --disassemble  write the instructions of the Intel HEX images INPUT_FILE as a source\\n\"");
+    iprintf(1 + indent, "\"  --stats[=json]  report timings and counters of the assembly on stderr\\n\"");
+    iprintf(1 + indent, "\"  --profile-out <FILE>  write the transition counts of the state machines to FILE, for\\n\"");
+    iprintf(1 + indent, "\"               ass --profile-in, the assembler must be compiled with -DASS_PROFILE=1\\n\"");
     iprintf(1 + indent, "\"\\n\"");
     iprintf(1 + indent, "\"FORMAT is the format of the output file. The available formats are:\\n\"");
     iprintf(1 + indent, "\"  hex          Intel HEX (default)\\n\"");
@@ -338,6 +500,10 @@ void generator_help_message(int indent)
     {
         iprintf(1 + indent, "\"  %-12s %s\\n\"", array[i].name, array[i].description);
     }
+    iprintf(1 + indent, "\"\\n\"");
+    iprintf(1 + indent, "\"Each line of a batch manifest is a job written as 'OUTPUT_FILE FORMAT INPUT_FILE...'.\\n\"");
+    iprintf(1 + indent, "\"FORMAT can be '-' to use the format set with -f, or the extension of OUTPUT_FILE.\\n\"");
+    iprintf(1 + indent, "\"Empty lines and lines starting with '#' are ignored.\\n\"");
     iprintf(1 + indent, ";");
 }
 
@@ -354,11 +520,41 @@ void generator_version_message(int indent)
     iprintf(1 + indent, "\"under certain conditions; refer to the license for details.\\n\";");
 }
 
+void generator_library_header(int indent)
+{
+    // Nothing to add for a standalone assembler
+    if (library_header == NULL)
+    {
+        iprintf(0, "");
+        return;
+    }
+
+    // Only include the header by its name, both files are expected to be in the same directory
+    char const *name = strrchr(library_header, '/');
+    name = (name == NULL) ? library_header : name + 1;
+
+    iprintf(0, "#define ASS_LIBRARY");
+    iprintf(0 + indent, "#define ASS_LIBRARY_HEADER \"%s\"", name);
+}
+
 void generator_notice(int indent)
 {
     iprintf(0, "/* A free assembler, made by ASS %i.%i.%i */", VERSION_MAJOR, VERSION_MINOR, VERSION_REVISION);
 }
 
+void generator_parameter_declarations(int indent)
+{
+    iprintf(0, "extern int64_t const ASS_P_opcode_width;");
+    iprintf(0 + indent, "extern int64_t const ASS_P_memory_width;");
+    iprintf(0 + indent, "extern int64_t const ASS_P_alignment;");
+    iprintf(0 + indent, "extern int64_t const ASS_P_address_width;");
+    iprintf(0 + indent, "extern int64_t const ASS_P_address_start;");
+    iprintf(0 + indent, "extern int64_t const ASS_P_address_stop;");
+    iprintf(0 + indent, "extern int const ASS_P_endianness;");
+    iprintf(0 + indent, "extern char const ASS_P_args_separator;");
+    iprintf(0 + indent, "extern char const ASS_P_label_postfix;");
+}
+
 void generator_parameters(int indent)
 {
     iprintf(0, "int64_t const ASS_P_opcode_width = %lli;", parameters.opcode_width);
@@ -395,29 +591,15 @@ void generator_data_types(int indent)
     iprintf(1 + indent, "} ASS_DT_t;");
 }
 
-void generator_lexer_actions(int indent)
+// Emit the lexer actions falling in a shard, the actions are dealt to the shards in turn
+static void lexer_actions(int indent, int shard, int shards)
 {
-    int duplicates[token_count];
+    int emitted = 0;
 
     for (size_t i = 0; i < token_count; i++)
     {
-        // Look if we have already genrated the token id
-        duplicates[i] = -1;
-        bool duplicated = false;
-        for (size_t j = 0; j < i; j++)
-        {
-            if (duplicates[j] == tokens_array[i].id)
-            {
-                duplicated = true;
-                break;
-            }
-        }
-
-        // Save the the id
-        duplicates[i] = tokens_array[i].id;
-
         // Generate the token id if it is not a duplicate
-        if (!duplicated)
+        if (token_first[i] && emitted++ % shards == shard)
         {
             if (tokens_array[i].action != NULL)
             {
@@ -438,31 +620,24 @@ void generator_lexer_actions(int indent)
     }
 }
 
-void generator_lexer_action_list(int indent)
+void generator_lexer_actions(int indent)
+{
+    // The actions have their own translation units
+    if (generator_split_user_code())
+        return;
+
+    lexer_actions(indent, 0, 1);
+}
+
+static void lexer_action_list(int indent)
 {
-    int duplicates[token_count];
 
     iprintf(0, "const ASS_action_t ASS_lexer_action_list[] = ");
     iprintf(0 + indent, "{");
     for (size_t i = 0; i < token_count; i++)
     {
-        // Look if we have already genrated the token id
-        duplicates[i] = -1;
-        bool duplicated = false;
-        for (size_t j = 0; j < i; j++)
-        {
-            if (duplicates[j] == tokens_array[i].id)
-            {
-                duplicated = true;
-                break;
-            }
-        }
-
-        // Save the the id
-        duplicates[i] = tokens_array[i].id;
-
         // Generate the token id if it is not a duplicate
-        if (!duplicated)
+        if (token_first[i])
         {
             iprintf(1 + indent,
                     "[ASS_T_%s] = (ASS_action_t){.action = ASS_TA_%s, .type = %s},",
@@ -474,29 +649,22 @@ void generator_lexer_action_list(int indent)
     iprintf(0 + indent, "};");
 }
 
-void generator_parser_actions(int indent)
+void generator_lexer_action_list(int indent)
 {
-    int duplicates[rule_count];
+    // The list is in the lexer translation unit
+    if (!split)
+        lexer_action_list(indent);
+}
+
+// Emit the parser actions falling in a shard, the actions are dealt to the shards in turn
+static void parser_actions(int indent, int shard, int shards)
+{
+    int emitted = 0;
 
     for (size_t i = 0; i < rule_count; i++)
     {
-        // Look if we have already generated the rule id
-        duplicates[i] = -1;
-        bool duplicated = false;
-        for (size_t j = 0; j < i; j++)
-        {
-            if (duplicates[j] == rules[i]->id)
-            {
-                duplicated = true;
-                break;
-            }
-        }
-
-        // Save the the id
-        duplicates[i] = rules[i]->id;
-
-        // Generate the rule id if it is not a duplicate
-        if (!duplicated)
+        // Generate the rule id if it is not a duplicate. Opcodes described by the encoding tables need no action
+        if (rule_first[i] && !(encoder_tables && rules[i]->data != NULL) && emitted++ % shards == shard)
         {
             if (rules[i]->action != NULL)
             {
@@ -518,61 +686,334 @@ void generator_parser_actions(int indent)
     }
 }
 
-void generator_parser_action_list(int indent)
+void generator_parser_actions(int indent)
+{
+    // The actions have their own translation units
+    if (generator_split_user_code())
+        return;
+
+    parser_actions(indent, 0, 1);
+}
+
+static void parser_action_list(int indent)
 {
-    int duplicates[rule_count];
 
     iprintf(0, "const ASS_action_t ASS_parser_action_list[] = ");
     iprintf(0 + indent, "{");
     for (size_t i = 0; i < rule_count; i++)
     {
-        // Look if we have already genrated the rule id
-        duplicates[i] = -1;
-        bool duplicated = false;
-        for (size_t j = 0; j < i; j++)
+        // Generate the rule id if it is not a duplicate
+        if (!rule_first[i])
+            continue;
+
+        if (encoder_tables && rules[i]->data != NULL)
+            iprintf(1 + indent, "[%i] = (ASS_action_t){.encoding = &ASS_encodings[%i], .type = ASS_U_NONE},", rules[i]->id, rules[i]->id);
+        else
+            iprintf(1 + indent, "[%i] = (ASS_action_t){.action = ASS_RA_%s, .type = ASS_U_NONE},", rules[i]->id, rules[i]->name);
+    }
+    iprintf(0 + indent, "};");
+}
+
+void generator_parser_action_list(int indent)
+{
+    // The list is in the parser translation unit
+    if (!split)
+        parser_action_list(indent);
+}
+
+// Get the operand fields of a format, in the order the opcode action handles them
+static int format_fields(bit_pattern_t const *format, field_desc_t *fields)
+{
+    int count = 0;
+
+    for (int i = format->count - 1; i >= 0; i--)
+    {
+        bit_elem_t const *bit_elem = &format->elems[i];
+        field_desc_t field = {.operand = bit_elem->index_mnemonic, .offset = bit_elem->offset, .width = bit_elem->width};
+
+        switch (bit_elem->type)
+        {
+        case eBP_IMMEDIATE:
+            field.kind = "ASS_FIELD_IMMEDIATE";
+            fields[count++] = field;
+            break;
+        case eBP_ENUM:
+            field.kind = "ASS_FIELD_ENUM";
+            fields[count++] = field;
+            break;
+        case eBP_LABEL_ABS:
+            field.kind = "ASS_FIELD_LABEL_ABS";
+            fields[count++] = field;
+            break;
+        case eBP_LABEL_REL:
+            field.kind = "ASS_FIELD_LABEL_REL";
+            fields[count++] = field;
+            break;
+        case eBP_ID:
+        case eBP_BIT_CONST:
+        case eBP_BIT_LIT:
+        case eBP_ELLIPSIS:
+            break;
+        default:
+            fail_error("Unknown bit pattern type");
+            exit(EXIT_FAILURE);
+            break;
+        }
+    }
+
+    return count;
+}
+
+static int format_operands(bit_pattern_t const *format, field_desc_t *operands, enumeration_t const **enumerations)
+{
+    // Same arguments as the rule of the parser, which stops at the first missing one
+    int count = 0;
+    for (int i = 0; i < format->argument_count && format->mnemonic_order[i] >= 0; i++)
+    {
+        bit_elem_t const *bit_elem = &format->elems[format->mnemonic_order[i]];
+        field_desc_t operand = {.operand = i, .offset = bit_elem->offset, .width = bit_elem->width};
+        enumerations[count] = NULL;
+
+        switch (bit_elem->type)
+        {
+        case eBP_IMMEDIATE:
+            operand.kind = "ASS_FIELD_IMMEDIATE";
+            break;
+        case eBP_ENUM:
+            operand.kind = "ASS_FIELD_ENUM";
+            enumerations[count] = bit_elem->enumeration;
+            break;
+        case eBP_LABEL_ABS:
+            operand.kind = "ASS_FIELD_LABEL_ABS";
+            break;
+        case eBP_LABEL_REL:
+            operand.kind = "ASS_FIELD_LABEL_REL";
+            break;
+        default:
+            fail_error("Unknown bit pattern type");
+            exit(EXIT_FAILURE);
+            break;
+        }
+        operands[count++] = operand;
+    }
+
+    return count;
+}
+
+static bool same_fields(field_desc_t const *a, field_desc_t const *b, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (strcmp(a[i].kind, b[i].kind) != 0 || a[i].operand != b[i].operand || a[i].offset != b[i].offset || a[i].width != b[i].width)
+            return false;
+    }
+    return true;
+}
+
+static void encoding_tables(int indent)
+{
+    if (!encoder_tables)
+        return;
+
+    // Operand fields of every opcode, the opcodes sharing a format share the same fields
+    darray_t *fields = darray_init(sizeof(field_desc_t));
+    int field_start[rule_count];
+    int field_count[rule_count];
+    uint64_t base[rule_count];
+
+    for (int i = 0; i < rule_count; i++)
+    {
+        if (rules[i]->data == NULL)
+            continue;
+
+        opcode_t const *opcode = rules[i]->data;
+        base[i] = bit_pattern_opcode_base(opcode);
+
+        // The fields only depend on the format, reuse the ones of a previous opcode of the same format
+        field_start[i] = -1;
+        for (int j = 0; j < i && field_start[i] < 0; j++)
         {
-            if (duplicates[j] == rules[i]->id)
+            if (rules[j]->data != NULL && ((opcode_t const *)rules[j]->data)->format == opcode->format)
             {
-                duplicated = true;
-                break;
+                field_start[i] = field_start[j];
+                field_count[i] = field_count[j];
             }
         }
+        if (field_start[i] >= 0)
+            continue;
 
-        // Save the the id
-        duplicates[i] = rules[i]->id;
+        field_desc_t opcode_field_list[opcode->format->count + 1];
+        field_count[i] = format_fields(opcode->format, opcode_field_list);
 
-        // Generate the rule id if it is not a duplicate
-        if (!duplicated)
-            iprintf(1 + indent, "[%i] = (ASS_action_t){.action = ASS_RA_%s, .type = ASS_U_NONE},", rules[i]->id, rules[i]->name);
+        // Reuse the fields of a previous format with the same layout
+        for (int j = 0; j < i && field_start[i] < 0; j++)
+        {
+            if (rules[j]->data != NULL && field_count[j] == field_count[i] &&
+                same_fields(darray_get_ptr(&fields, field_start[j]), opcode_field_list, field_count[i]))
+                field_start[i] = field_start[j];
+        }
+
+        if (field_start[i] < 0)
+        {
+            field_start[i] = fields->count;
+            for (int j = 0; j < field_count[i]; j++)
+                darray_add(&fields, opcode_field_list[j]);
+        }
     }
+
+    // Both tables end with an empty entry, so they are never empty
+    iprintf(0, "const ASS_field_t ASS_fields[] = {");
+    field_desc_t *field_list = darray_get_ptr(&fields, 0);
+    for (size_t i = 0; i < fields->count; i++)
+        iprintf(1 + indent, "{%s, %i, %i, %i},", field_list[i].kind, field_list[i].operand, field_list[i].offset, field_list[i].width);
+    iprintf(1 + indent, "{0},");
     iprintf(0 + indent, "};");
+    iprintf(0, "");
+
+    iprintf(0 + indent, "const ASS_encoding_t ASS_encodings[] = {");
+    for (int i = 0; i < rule_count; i++)
+    {
+        if (rules[i]->data != NULL)
+            iprintf(1 + indent, "[%i] = {0x%llXLLU, &ASS_fields[%i], %i}, // %s",
+                    rules[i]->id, base[i], field_start[i], field_count[i], rules[i]->name);
+    }
+    iprintf(1 + indent, "{0},");
+    iprintf(0 + indent, "};");
+
+    darray_destroy(&fields);
 }
 
-void generator_token_enum(int indent)
+void generator_encoding_tables(int indent)
 {
-    int duplicates[token_count];
+    // The tables are in the parser translation unit
+    if (!split)
+        encoding_tables(indent);
+}
 
-    iprintf(0, "typedef enum");
-    iprintf(0 + indent, "{");
-    for (size_t i = 0; i < token_count; i++)
+void generator_profile_tables(int indent)
+{
+    // The tables are in the lexer and parser translation units
+    if (!split)
     {
-        // Look if we have already genrated the token id
-        duplicates[i] = -1;
-        bool duplicated = false;
-        for (size_t j = 0; j < i; j++)
+        profile_table(indent, lexer_dfa, "lexer");
+        profile_table(indent, parser_dfa, "parser");
+    }
+}
+
+void generator_disassembly_tables(int indent)
+{
+    int opcode_count = opcode_array->count;
+    opcode_t const *opcodes = darray_get_ptr(&opcode_array, 0);
+    uint64_t word_mask = parameters.opcode_width >= 64 ? 0xFFFFFFFFFFFFFFFFLLU : ~(0xFFFFFFFFFFFFFFFFLLU << parameters.opcode_width);
+
+    // Text of the patterns of each enum, to print the enum operands back
+    int enum_count = hash_count(enum_array);
+    bucket_t **enums = hash_serialise(enum_array);
+    for (int i = 0; i < enum_count; i++)
+    {
+        enumeration_t const *enumeration = enums[i]->user_data;
+        uint64_t mask = ~(0xFFFFFFFFFFFFFFFFLLU << enumeration->width);
+
+        iprintf(0, "const ASS_enum_pattern_t ASS_enum_%s[] = {", enumeration->name);
+        for (linked_list_t *current = enumeration->pattern_list; current != NULL; current = current->next)
         {
-            if (duplicates[j] == tokens_array[i].id)
+            pattern_t const *pattern = current->user_data;
+            sbuilder_repeat(output, ' ', 4 * (1 + indent));
+            sbuilder_printf(output, "{0x%llXLLU, ", (unsigned long long)(pattern->bit_const.val & mask));
+            c_string(pattern->pattern);
+            sbuilder_puts(output, "},\n");
+        }
+        iprintf(1 + indent, "{0},");
+        iprintf(0 + indent, "};");
+    }
+    iprintf(0, "");
+
+    // Operands of every format, shared by its opcodes
+    int operand_start[opcode_count + 1];
+    int operand_count[opcode_count + 1];
+    int total = 0;
+    iprintf(0, "const ASS_operand_t ASS_operands[] = {");
+    for (int i = 0; i < opcode_count; i++)
+    {
+        operand_start[i] = -1;
+        for (int j = 0; j < i && operand_start[i] < 0; j++)
+        {
+            if (opcodes[j].format == opcodes[i].format)
             {
-                duplicated = true;
-                break;
+                operand_start[i] = operand_start[j];
+                operand_count[i] = operand_count[j];
             }
         }
+        if (operand_start[i] >= 0)
+            continue;
+
+        field_desc_t operands[opcodes[i].format->count + 1];
+        enumeration_t const *enumerations[opcodes[i].format->count + 1];
+        operand_start[i] = total;
+        operand_count[i] = format_operands(opcodes[i].format, operands, enumerations);
+        total += operand_count[i];
+        for (int j = 0; j < operand_count[i]; j++)
+        {
+            if (enumerations[j] != NULL)
+                iprintf(1 + indent, "{%s, %i, %i, ASS_enum_%s, %i},", operands[j].kind, operands[j].offset, operands[j].width,
+                        enumerations[j]->name, list_get_lenght(enumerations[j]->pattern_list));
+            else
+                iprintf(1 + indent, "{%s, %i, %i, NULL, 0},", operands[j].kind, operands[j].offset, operands[j].width);
+        }
+    }
+    iprintf(1 + indent, "{0},");
+    iprintf(0 + indent, "};");
+    iprintf(0, "");
+
+    // The bits above the opcode width are never set by the assembler, so they are fixed to 0 too
+    uint64_t masks[opcode_count + 1];
+    uint64_t values[opcode_count + 1];
+    iprintf(0, "const ASS_instruction_t ASS_instructions[] = {");
+    for (int i = 0; i < opcode_count; i++)
+    {
+        masks[i] = opcodes[i].format->fixed & word_mask;
+        values[i] = bit_pattern_opcode_base(&opcodes[i]) & masks[i];
+
+        sbuilder_repeat(output, ' ', 4 * (1 + indent));
+        sbuilder_puts(output, "{");
+        c_string(opcodes[i].text_pattern);
+        sbuilder_printf(output, ", 0x%llXLLU, 0x%llXLLU, &ASS_operands[%i], %i},\n",
+                        (unsigned long long)(masks[i] | ~word_mask), (unsigned long long)values[i], operand_start[i], operand_count[i]);
+    }
+    iprintf(1 + indent, "{0},");
+    iprintf(0 + indent, "};");
+    iprintf(0, "");
+
+    // Decision tree on the fixed bits, the root first
+    decoder_t *decoder = decoder_build(opcode_count, masks, values, parameters.opcode_width);
+    decoder_node_t const *nodes = darray_get_ptr(&(decoder->nodes), 0);
+    iprintf(0, "const ASS_decode_node_t ASS_decode_nodes[] = {");
+    for (size_t i = 0; i < decoder->nodes->count; i++)
+        iprintf(1 + indent, "{%i, %i, %i, %i},", nodes[i].shift, nodes[i].width, nodes[i].first, nodes[i].count);
+    iprintf(0 + indent, "};");
+    iprintf(0, "");
+
+    int const *candidates = darray_get_ptr(&(decoder->candidates), 0);
+    iprintf(0, "const int ASS_decode_candidates[] = {");
+    sbuilder_repeat(output, ' ', 4 * (1 + indent));
+    for (size_t i = 0; i < decoder->candidates->count; i++)
+        sbuilder_printf(output, "%i, ", candidates[i]);
+    sbuilder_puts(output, "0\n");
+    iprintf(0 + indent, "};");
+
+    fail_debug("Disassembler decision tree: %zu nodes, %zu candidates", decoder->nodes->count, decoder->candidates->count);
+    decoder_destroy(decoder);
+}
 
-        // Save the the id
-        duplicates[i] = tokens_array[i].id;
+void generator_token_enum(int indent)
+{
 
+    iprintf(0, "typedef enum");
+    iprintf(0 + indent, "{");
+    for (size_t i = 0; i < token_count; i++)
+    {
         // Generate the token id if it is not a duplicate
-        if (!duplicated)
+        if (token_first[i])
             iprintf(1 + indent, "ASS_T_%s = %i,", tokens_array[i].name, tokens_array[i].id);
     }
     iprintf(0 + indent, "} ASS_token_t;");
@@ -588,44 +1029,214 @@ void generator_token_names(int indent)
     iprintf(0 + indent, "};");
 }
 
+void generator_token_classes(int indent)
+{
+    iprintf(0, "const ASS_token_t ASS_token_class[] = {");
+    for (size_t i = 0; i < token_count; i++)
+    {
+        iprintf(1 + indent, "[ASS_T_%s] = %i,", tokens_array[i].name, tokens_array[i].token_class);
+    }
+    iprintf(0 + indent, "};");
+}
+
 void generator_lexer_switch(int indent)
 {
-    generator_dfa_switch(indent, lexer_dfa, "lexer");
+    // The state machine has its own translation unit
+    if (split)
+        iprintf(0, "ASS_lexer_switch();");
+    else
+        generator_dfa_switch(indent, lexer_dfa, "lexer");
 }
 
 void generator_parser_switch(int indent)
 {
-    generator_dfa_switch(indent, parser_dfa, "parser");
+    // The state machine has its own translation unit
+    if (split)
+        iprintf(0, "ASS_parser_switch();");
+    else
+        generator_dfa_switch(indent, parser_dfa, "parser");
+}
+
+void generator_stack_depths(int indent)
+{
+    int longest_token = generator_longest_path(lexer_dfa);
+
+    // The parser stack is emptied after each rule
+    iprintf(0, "#define ASS_PARSER_STACK_DEPTH %i", generator_longest_rule());
+
+    // Patterns with repetitions make the tokens only bounded by the line length. The stack also receives the '\0'
+    if (longest_token < 0)
+    {
+        iprintf(0 + indent, "#define ASS_LEXER_STACK_DEPTH ASS_MAX_LINE_LENGTH");
+        iprintf(0 + indent, "#define ASS_LEXER_STACK_BOUNDED 0");
+    }
+    else
+    {
+        iprintf(0 + indent, "#define ASS_LEXER_STACK_DEPTH %i", longest_token + 1);
+        iprintf(0 + indent, "#define ASS_LEXER_STACK_BOUNDED 1");
+    }
+}
+
+int generator_longest_rule()
+{
+    int longest = 0;
+
+    for (int i = 0; i < rule_count; i++)
+    {
+        int length = 0;
+        bool in_set = false;
+
+        for (int j = 0; j < rules[i]->count; j++)
+        {
+            if (rules[i]->tokens[j] == -(int)'[')
+            {
+                in_set = true;
+                length++;
+            }
+            else if (rules[i]->tokens[j] == -(int)']')
+                in_set = false;
+            else if (!in_set)
+                length++;
+        }
+
+        if (length > longest)
+            longest = length;
+    }
+
+    return longest;
+}
+
+// Depth first search of the longest path, states on the current path are marked with -2
+static int longest_path_from(state_machine_t *state_machine, state_t *state, int *lengths)
+{
+    state_t *first = darray_get_ptr(&(state_machine->states_tstate), 0);
+    int index = state - first;
+
+    if (lengths[index] == -2)
+        return -1; // Loop
+    if (lengths[index] >= 0)
+        return lengths[index];
+
+    lengths[index] = -2;
+    int longest = 0;
+    for (size_t i = 0; i < state->transitions_ttrans->count; i++)
+    {
+        transistion_t *transition = darray_get_ptr(&(state->transitions_ttrans), i);
+        int length = longest_path_from(state_machine, state_machine_get_by_id(state_machine, transition->next_state_id), lengths);
+        if (length < 0)
+            return -1;
+        if (length + 1 > longest)
+            longest = length + 1;
+    }
+    lengths[index] = longest;
+
+    return longest;
+}
+
+int generator_longest_path(state_machine_t *state_machine)
+{
+    int count = state_machine->states_tstate->count;
+    int *lengths = xmalloc(sizeof(int) * count);
+    for (int i = 0; i < count; i++)
+        lengths[i] = -1;
+
+    int longest = longest_path_from(state_machine, state_machine_get_by_id(state_machine, 0), lengths);
+
+    free(lengths);
+    return longest;
+}
+
+static void dfa_transition(int indent, state_machine_t *state_machine, char const *name, int next_state_id, int site)
+{
+    state_t *next_state = state_machine_get_by_id(state_machine, next_state_id);
+    iprintf(indent, "ASS_PROFILE_HIT(ASS_%s_profile, %i);", name, site);
+    iprintf(indent, "ASS_%s_state = %i;", name, next_state_id);
+    iprintf(indent, "ASS_%s_valid = %s;", name, next_state->end_state ? "true" : "false");
+    iprintf(indent, "ASS_%s_output = %i;", name, next_state->output);
+    iprintf(indent, "break;");
 }
 
 void generator_dfa_switch(int indent, state_machine_t *state_machine, char *name)
 {
+    size_t state_count = state_machine->states_tstate->count;
+    state_t *states = darray_get_ptr(&(state_machine->states_tstate), 0);
+
+    // First profile site of each state, in the order of the states
+    int *first_site = xmalloc(sizeof(int) * (state_count + 1));
+    first_site[0] = 0;
+    for (size_t i = 0; i < state_count; i++)
+        first_site[i + 1] = first_site[i] + transition_sites(&states[i], NULL) + 2;
+
     iprintf(0, "switch (ASS_%s_state)", name);
     iprintf(1 + indent, "{");
 
-    for (size_t i = 0; i < state_machine->states_tstate->count; i++)
+    bool profiled = profile_select(name, machine_fingerprint(state_machine));
+    size_t *order = hot_order(state_machine, name, profiled);
+    for (size_t k = 0; k < state_count; k++)
     {
-        state_t *state = darray_get_ptr(&(state_machine->states_tstate), i);
+        state_t *state = &states[order[k]];
+        transistion_t *transitions = darray_get_ptr(&(state->transitions_ttrans), 0);
+        size_t transition_count = state->transitions_ttrans->count;
+        int sites[transition_count + 1];
+        int site_count = transition_sites(state, sites);
+        int base = first_site[order[k]];
 
         iprintf(0 + indent, "case %i:", state->id);
         iprintf(1 + indent, "switch (ASS_%s_token)", name);
         iprintf(1 + indent, "{");
 
-        for (size_t j = 0; j < state->transitions_ttrans->count; j++)
+        // Without a profile, the transitions keep their order and consecutive ones to the same state share their code.
+        // With a profile, all the transitions to a same state are grouped, the hottest group first
+        if (profiled)
         {
-            transistion_t *transition = darray_get_ptr(&(state->transitions_ttrans), j);
-            iprintf(1 + indent, "case %i:", transition->condition);
-            if (j >= state->transitions_ttrans->count || transition->next_state_id != (transition + 1)->next_state_id)
+            uint64_t site_hits[site_count + 1];
+            bool done[site_count + 1];
+            for (int j = 0; j < site_count; j++)
+            {
+                site_hits[j] = profile_count(name, state->id, target_of_site(state, sites, j));
+                done[j] = false;
+            }
+
+            for (int group = 0; group < site_count; group++)
             {
-                iprintf(2 + indent, "ASS_%s_state = %i;", name, transition->next_state_id);
-                iprintf(2 + indent, "ASS_%s_valid = %s;", name, state_machine_get_by_id(state_machine, transition->next_state_id)->end_state ? "true" : "false");
-                iprintf(2 + indent, "ASS_%s_output = %i;", name, state_machine_get_by_id(state_machine, transition->next_state_id)->output);
-                iprintf(2 + indent, "break;");
+                // The hottest group left, the first one on a tie
+                int site = -1;
+                for (int j = 0; j < site_count; j++)
+                {
+                    if (!done[j] && (site < 0 || site_hits[j] > site_hits[site]))
+                        site = j;
+                }
+                done[site] = true;
+
+                for (size_t j = 0; j < transition_count; j++)
+                {
+                    if (sites[j] == site)
+                        iprintf(1 + indent, "case %i:", transitions[j].condition);
+                }
+                dfa_transition(2 + indent, state_machine, name, target_of_site(state, sites, site), base + site);
             }
         }
+        else
+        {
+            for (size_t j = 0; j < transition_count; j++)
+            {
+                iprintf(1 + indent, "case %i:", transitions[j].condition);
+                if (j + 1 >= transition_count || transitions[j].next_state_id != transitions[j + 1].next_state_id)
+                    dfa_transition(2 + indent, state_machine, name, transitions[j].next_state_id, base + sites[j]);
+            }
+        }
+
+        // The exit and the invalid token are the two sites after the transitions
+        uint64_t exits = profile_count(name, state->id, PROFILE_EXIT);
+        uint64_t invalids = profile_count(name, state->id, PROFILE_INVALID);
+        char const *hint = exits > invalids ? "ASS_LIKELY" : invalids > exits ? "ASS_UNLIKELY" : NULL;
 
         iprintf(1 + indent, "default:");
-        iprintf(2 + indent, "if(ASS_%s_valid)", name);
+        iprintf(2 + indent, "ASS_PROFILE_HIT(ASS_%s_profile, %i + !ASS_%s_valid);", name, base + site_count, name);
+        if (hint != NULL)
+            iprintf(2 + indent, "if(%s(ASS_%s_valid))", hint, name);
+        else
+            iprintf(2 + indent, "if(ASS_%s_valid)", name);
         iprintf(3 + indent, "ASS_%s_exit_point();", name);
         iprintf(2 + indent, "else");
         iprintf(3 + indent, "ASS_%s_invalid_token();", name);
@@ -638,50 +1249,337 @@ void generator_dfa_switch(int indent, state_machine_t *state_machine, char *name
     iprintf(1 + indent, "fprintf(stderr, \"state machine error\\n\");");
     iprintf(1 + indent, "abort();");
     iprintf(0 + indent, "}");
+
+    free(order);
+    free(first_site);
+}
+
+/**************************************************/
+/*               TRANSLATION UNITS                */
+/**************************************************/
+
+void generator_lexer_unit(void)
+{
+    // The actions are defined in the action units, or in the core
+    for (size_t i = 0; i < token_count; i++)
+    {
+        if (token_first[i])
+            iprintf(0, "ASS_data_t ASS_TA_%s();", tokens_array[i].name);
+    }
+    iprintf(0, "");
+
+    lexer_action_list(0);
+    iprintf(0, "");
+
+    profile_table(0, lexer_dfa, "lexer");
+    iprintf(0, "");
+
+    iprintf(0, "void ASS_lexer_switch(void)");
+    iprintf(0, "{");
+    sbuilder_repeat(output, ' ', 4);
+    generator_dfa_switch(1, lexer_dfa, "lexer");
+    iprintf(0, "}");
+}
+
+void generator_parser_unit(void)
+{
+    for (size_t i = 0; i < rule_count; i++)
+    {
+        if (rule_first[i] && !(encoder_tables && rules[i]->data != NULL))
+            iprintf(0, "ASS_data_t ASS_RA_%s();", rules[i]->name);
+    }
+    iprintf(0, "");
+
+    encoding_tables(0);
+    iprintf(0, "");
+
+    parser_action_list(0);
+    iprintf(0, "");
+
+    profile_table(0, parser_dfa, "parser");
+    iprintf(0, "");
+
+    iprintf(0, "void ASS_parser_switch(void)");
+    iprintf(0, "{");
+    sbuilder_repeat(output, ' ', 4);
+    generator_dfa_switch(1, parser_dfa, "parser");
+    iprintf(0, "}");
+}
+
+void generator_actions_unit(int shard, int shards)
+{
+    lexer_actions(0, shard, shards);
+    iprintf(0, "");
+    parser_actions(0, shard, shards);
+}
+
+void generator_outputs_unit(void)
+{
+    custom_output_t *array = darray_get_ptr(&custom_output_array, 0);
+    for (int i = 0; i < custom_output_array->count; i++)
+    {
+        iprintf(0, "void ASS_output_%s(FILE* fd)", array[i].name);
+        iprintf(0, "{");
+        iprintf(1, "%s", array[i].code);
+        iprintf(0, "}");
+    }
+}
+
+void generator_makefile(char const *const *units, int count)
+{
+    iprintf(0, "# Build the assembler from its translation units, \"make -j\" compiles them in parallel");
+    iprintf(0, "CFLAGS = -O2");
+    iprintf(0, "LDLIBS = -lm");
+    sbuilder_puts(output, "OBJS =");
+    for (int i = 0; i < count; i++)
+        sbuilder_printf(output, " %s.o", units[i]);
+    iprintf(0, "");
+    iprintf(0, "");
+
+    // A library is archived, the application links it with its own main
+    if (library_header != NULL)
+    {
+        iprintf(0, "libassembler.a: $(OBJS)");
+        iprintf(0, "\t$(AR) rcs $@ $(OBJS)");
+    }
+    else
+    {
+        iprintf(0, "assembler: $(OBJS)");
+        iprintf(0, "\t$(CC) $(CFLAGS) -o $@ $(OBJS) $(LDLIBS)");
+    }
+    iprintf(0, "");
+
+    iprintf(0, "%%.o: %%.c assembler.h");
+    iprintf(0, "\t$(CC) $(CFLAGS) -c -o $@ $<");
+    iprintf(0, "");
+
+    // The transition counters for ass --profile-in have their own build, the compiler PGO builds are trained and
+    // optimised without them so the released assembler does not count
+    if (library_header == NULL)
+    {
+        iprintf(0, "# Profile-guided build, on representative sources:");
+        iprintf(0, "# - \"make profile-counters\", run ./assembler --profile-out FILE, and give FILE to ass --profile-in to");
+        iprintf(0, "#   generate the assembler again");
+        iprintf(0, "# - \"make profile-generate\", run ./assembler, then \"make profile-use\"");
+        iprintf(0, "profile-counters: clean");
+        iprintf(0, "\t$(MAKE) CFLAGS=\"$(CFLAGS) -DASS_PROFILE=1\"");
+        iprintf(0, "");
+        iprintf(0, "profile-generate: clean");
+        iprintf(0, "\t$(MAKE) CFLAGS=\"$(CFLAGS) -fprofile-generate\"");
+        iprintf(0, "");
+        iprintf(0, "profile-use:");
+        iprintf(0, "\trm -f assembler $(OBJS)");
+        iprintf(0, "\t$(MAKE) CFLAGS=\"$(CFLAGS) -fprofile-use -Wno-missing-profile\"");
+        iprintf(0, "");
+    }
+
+    iprintf(0, "clean:");
+    iprintf(0, "\trm -f assembler libassembler.a $(OBJS) *.gcda");
+    iprintf(0, "");
+    iprintf(0, ".PHONY: clean%s", library_header == NULL ? " profile-counters profile-generate profile-use" : "");
 }
 
 /*********************************************************************/
 
-// Print to a dynamic array buffer
-void bprintf(darray_t **array, const char *format, ...)
+// Print a line to a string builder
+void bprintf(string_builder_t *builder, const char *format, ...)
 {
-    int len;
-    char buff[1024];
-    char tmp;
+    va_list args;
+    va_start(args, format);
+    sbuilder_vprintf(builder, format, args);
+    va_end(args);
+    sbuilder_append(builder, "\n", 1);
+}
 
-    // Print to the buffer
+void iprintf(size_t indentation, const char *format, ...)
+{
     va_list args;
     va_start(args, format);
-    len = vsnprintf(buff, 1024, format, args);
+    sbuilder_repeat(output, ' ', 4 * indentation);
+    sbuilder_vprintf(output, format, args);
+    sbuilder_append(output, "\n", 1);
     va_end(args);
+}
 
-    // Remove that last character of the string in the
-    //  array, as it is normally a NULL
-    darray_remove(array, 1);
+static void c_string(char const *str)
+{
+    sbuilder_puts(output, "\"");
+    for (; *str != '\0'; str++)
+    {
+        if (*str == '"' || *str == '\\')
+            sbuilder_printf(output, "\\%c", *str);
+        else if (*str < ' ' || *str > '~')
+            sbuilder_printf(output, "\\%03o", (unsigned char)*str);
+        else
+            sbuilder_append(output, str, 1);
+    }
+    sbuilder_puts(output, "\"");
+}
 
-    // Skip the NULL
-    // NOTE: Inefficient
-    for (int i = 0; i < len; i++)
+static bool *first_occurrences(int const *ids, int count)
+{
+    // Open addressing with linear probing, kept at most half full
+    int capacity = 16;
+    while (capacity < 2 * count)
+        capacity *= 2;
+
+    int *slots = xmalloc(sizeof(int) * capacity);
+    bool *used = xmalloc(sizeof(bool) * capacity);
+    memset(used, 0, sizeof(bool) * capacity);
+
+    bool *first = xmalloc(sizeof(bool) * (count + 1));
+    for (int i = 0; i < count; i++)
     {
-        darray_add(array, buff[i]);
+        uint32_t slot = ((uint32_t)ids[i] * 2654435769u) & (capacity - 1);
+        while (used[slot] && slots[slot] != ids[i])
+            slot = (slot + 1) & (capacity - 1);
+
+        first[i] = !used[slot];
+        used[slot] = true;
+        slots[slot] = ids[i];
     }
-    tmp = '\n';
-    darray_add(array, tmp);
-    tmp = '\0';
-    darray_add(array, tmp);
+
+    free(slots);
+    free(used);
+    return first;
 }
 
-void iprintf(size_t indentation, const char *format, ...)
+static int transition_sites(state_t *state, int *sites)
 {
-    va_list args;
-    va_start(args, format);
-    for (size_t i = 0; i < indentation; i++)
+    transistion_t *transitions = darray_get_ptr(&(state->transitions_ttrans), 0);
+    size_t transition_count = state->transitions_ttrans->count;
+    int local_sites[transition_count + 1];
+    if (sites == NULL)
+        sites = local_sites;
+
+    int count = 0;
+    for (size_t i = 0; i < transition_count; i++)
     {
-        fputs("    ", fd);
+        sites[i] = count;
+        for (size_t j = 0; j < i; j++)
+        {
+            if (transitions[j].next_state_id == transitions[i].next_state_id)
+            {
+                sites[i] = sites[j];
+                break;
+            }
+        }
+        if (sites[i] == count)
+            count++;
     }
-    vfprintf(fd, format, args);
-    fputc('\n', fd);
-    va_end(args);
+    return count;
+}
+
+static int target_of_site(state_t *state, int const *sites, int site)
+{
+    transistion_t *transitions = darray_get_ptr(&(state->transitions_ttrans), 0);
+    for (size_t i = 0; i < state->transitions_ttrans->count; i++)
+    {
+        if (sites[i] == site)
+            return transitions[i].next_state_id;
+    }
+    return PROFILE_EXIT;
+}
+
+typedef struct
+{
+    uint64_t hits;
+    size_t index;
+} hot_state_t;
+
+// Most visited first, then in the order of the state machine
+static int hot_state_cmp(void const *a, void const *b)
+{
+    hot_state_t const *state_a = a;
+    hot_state_t const *state_b = b;
+    if (state_a->hits != state_b->hits)
+        return state_a->hits < state_b->hits ? 1 : -1;
+    return state_a->index < state_b->index ? -1 : state_a->index > state_b->index;
+}
+
+static size_t *hot_order(state_machine_t *state_machine, char const *name, bool profiled)
+{
+    size_t count = state_machine->states_tstate->count;
+    state_t *states = darray_get_ptr(&(state_machine->states_tstate), 0);
+    hot_state_t *hot = xmalloc(sizeof(hot_state_t) * (count + 1));
+
+    for (size_t i = 0; i < count; i++)
+    {
+        int sites[states[i].transitions_ttrans->count + 1];
+        int site_count = transition_sites(&states[i], sites);
+
+        hot[i].index = i;
+        hot[i].hits = profile_count(name, states[i].id, PROFILE_EXIT) + profile_count(name, states[i].id, PROFILE_INVALID);
+        for (int site = 0; site < site_count; site++)
+            hot[i].hits += profile_count(name, states[i].id, target_of_site(&states[i], sites, site));
+    }
+
+    if (profiled)
+        qsort(hot, count, sizeof(hot_state_t), hot_state_cmp);
+
+    size_t *order = xmalloc(sizeof(size_t) * (count + 1));
+    for (size_t i = 0; i < count; i++)
+        order[i] = hot[i].index;
+    free(hot);
+    return order;
+}
+
+static uint64_t machine_fingerprint(state_machine_t *state_machine)
+{
+    uint64_t fingerprint = CACHE_HASH_INIT;
+    for (size_t i = 0; i < state_machine->states_tstate->count; i++)
+    {
+        state_t *state = darray_get_ptr(&(state_machine->states_tstate), i);
+        int const header[] = {state->id, state->end_state, state->output, state->transitions_ttrans->count};
+        fingerprint = cache_hash(fingerprint, header, sizeof(header));
+
+        transistion_t *transitions = darray_get_ptr(&(state->transitions_ttrans), 0);
+        for (size_t j = 0; j < state->transitions_ttrans->count; j++)
+        {
+            int const transition[] = {transitions[j].condition, transitions[j].next_state_id};
+            fingerprint = cache_hash(fingerprint, transition, sizeof(transition));
+        }
+    }
+    return fingerprint;
+}
+
+static void profile_table(int indent, state_machine_t *state_machine, char const *name)
+{
+    size_t count = state_machine->states_tstate->count;
+    state_t *states = darray_get_ptr(&(state_machine->states_tstate), 0);
+
+    int total = 0;
+    for (size_t i = 0; i < count; i++)
+        total += transition_sites(&states[i], NULL) + 2;
+
+    iprintf(0, "#if ASS_PROFILE");
+    iprintf(indent, "uint64_t ASS_%s_profile[%i];", name, total);
+    iprintf(indent, "const int ASS_%s_profile_size = %i;", name, total);
+    iprintf(indent, "const uint64_t ASS_%s_profile_fingerprint = 0x%016llXLLU;", name, (unsigned long long)machine_fingerprint(state_machine));
+    iprintf(indent, "const ASS_profile_site_t ASS_%s_profile_sites[] = {", name);
+
+    // One line per state, in the order of the counters
+    for (size_t i = 0; i < count; i++)
+    {
+        transistion_t *transitions = darray_get_ptr(&(states[i].transitions_ttrans), 0);
+        int sites[states[i].transitions_ttrans->count + 1];
+        int emitted = 0;
+        transition_sites(&states[i], sites);
+
+        sbuilder_repeat(output, ' ', 4 * (1 + indent));
+        for (size_t j = 0; j < states[i].transitions_ttrans->count; j++)
+        {
+            if (sites[j] == emitted)
+            {
+                sbuilder_printf(output, "{%i, %i}, ", states[i].id, transitions[j].next_state_id);
+                emitted++;
+            }
+        }
+        sbuilder_printf(output, "{%i, ASS_PROFILE_EXIT}, {%i, ASS_PROFILE_INVALID},\n", states[i].id, states[i].id);
+    }
+
+    iprintf(indent, "};");
+    iprintf(0, "#endif");
 }
 
 void xmalloc_callback(int err)
@@ -17,6 +17,7 @@
 #include "bitpattern.h"
 #include "ast_node.h"
 #include "version.h"
+#include "string_builder.h"
 
 /**
  * @brief Set the file descriptor for the generator
@@ -25,6 +26,92 @@
  */
 void generator_set_file_descriptor(FILE *file_descriptor);
 
+/**
+ * @brief Append raw text to the output, kept in memory until generator_flush is called
+ *
+ * @param text The text
+ * @param length Number of bytes of the text
+ */
+void generator_emit(char const *text, size_t length);
+
+/**
+ * @brief Write everything emitted since the last flush to the file descriptor, in a single write
+ *
+ * @return true if the whole output has been written
+ */
+bool generator_flush(void);
+
+/**
+ * @brief Get the number of bytes flushed so far, over every file the generator wrote to
+ *
+ * @return size_t The number of bytes
+ */
+size_t generator_flushed_size(void);
+
+/**
+ * @brief Emit the assembler as a library, without main
+ *
+ * @param header_name Path of the header declaring the library API, NULL to emit a standalone assembler
+ */
+void generator_set_library_header(char const *header_name);
+
+/**
+ * @brief Select how the opcodes are encoded by the generated assembler
+ *
+ * @param tables true to describe the opcodes with field tables read by a single encoding function,
+ *               false to emit one encoding function per opcode
+ */
+void generator_set_encoder_tables(bool tables);
+
+/**
+ * @brief Emit the assembler as separate translation units sharing a header
+ *
+ * @param split_units true to leave the state machines, the tables, the actions and the
+ *                    custom outputs to the generator_*_unit functions instead of the core
+ */
+void generator_set_split(bool split_units);
+
+/**
+ * @brief Check if the actions and the custom outputs are emitted in their own translation units
+ *
+ * @details They stay in the core when the description has custom code, as they may use
+ *          anything it defines
+ *
+ * @return true if the core only declares them
+ */
+bool generator_split_user_code(void);
+
+/**
+ * @brief Generate the lexer translation unit: the action list and the state machine
+ */
+void generator_lexer_unit(void);
+
+/**
+ * @brief Generate the parser translation unit: the encoding tables, the action list and the state machine
+ */
+void generator_parser_unit(void);
+
+/**
+ * @brief Generate a translation unit holding a share of the lexer and parser actions
+ *
+ * @param shard Index of the share, from 0 to shards - 1
+ * @param shards Number of shares the actions are dealt to
+ */
+void generator_actions_unit(int shard, int shards);
+
+/**
+ * @brief Generate the translation unit of the custom outputs
+ */
+void generator_outputs_unit(void);
+
+/**
+ * @brief Generate the Makefile building the translation units
+ *
+ * @param units Names of the translation units, without the ".c" extension
+ * @param count Number of translation units
+ */
+void generator_makefile(char const *const *units, int count);
+
 /**
  * @brief Generate the lexer from a list of tokens
  *
@@ -74,6 +161,9 @@ void generator_custom_code(int indent);
 void generator_help_message(int indent);
 void generator_version_message(int indent);
 void generator_notice(int indent);
+void generator_library_header(int indent);
+void generator_stack_depths(int indent);
+void generator_parameter_declarations(int indent);
 void generator_parameters(int indent);
 void generator_data_union(int indent);
 void generator_data_types(int indent);
@@ -85,3 +175,7 @@ void generator_parser_action_list(int indent);
 void generator_parser_switch(int indent);
 void generator_token_enum(int indent);
 void generator_token_names(int indent);
+void generator_token_classes(int indent);
+void generator_encoding_tables(int indent);
+void generator_profile_tables(int indent);
+void generator_disassembly_tables(int indent);
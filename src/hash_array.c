@@ -8,185 +8,111 @@
 #include "xmalloc.h"
 #include "macro.h"
 
-bucket_t* bucket_init(char* key, void* user_data);
-void bucket_add(bucket_t* self, bucket_t* new_bucket);
-bucket_t* bucket_find(bucket_t* self, char* key);
-uint32_t bucket_count(bucket_t* self);
-size_t bucket_push_to_array(bucket_t* self, bucket_t** serialised_data);
+#define EMPTY_SLOT -1
+#define MIN_CAPACITY 16
+
+bucket_t* bucket_init(char* key, void* user_data, uint32_t hash_val);
 
 uint32_t hash(unsigned char *str);
+static int32_t* find_slot(hash_t* self, char* key, uint32_t hash_val);
+static void rebuild_slots(hash_t* self, int capacity);
 static void xmalloc_callback(int err);
 
 /********************************************************/
 
 
-bucket_t* bucket_init(char* key, void* user_data)
+bucket_t* bucket_init(char* key, void* user_data, uint32_t hash_val)
 {
     bucket_t* new_bucket;
     int len = strlen(key) + 1;
     xmalloc_set_handler(xmalloc_callback);
     new_bucket = xmalloc(sizeof(bucket_t) + len);
     new_bucket->user_data = user_data;
-    new_bucket->previous = NULL;  //Initalised as a floating bucket
-    new_bucket->next = NULL;
+    new_bucket->hash = hash_val;
     strcpy(new_bucket->key, key);
     return new_bucket;
 }
 
-void bucket_add(bucket_t* self, bucket_t* new_bucket)
-{
-    bucket_t* current = self;
-
-    //Find the last bucket of the list
-    while(current->next)
-    {
-        current = current->next;
-    }
-
-    //Add the bucket to the end
-    current->next = new_bucket;
-    new_bucket->previous = current;
-}
-
-/* TODO: Implement a way to remove buckets
-bucket_t* bucket_remove(bucket_t* self, char* key)
-{
-    bucket_t* current_bucket = bucket_find();
-    if
-}
-*/
-
-bucket_t* bucket_find(bucket_t* self, char* key)
-{
-    bucket_t* current = self;
-
-    //Find the last bucket of the list
-    while(current)
-    {
-        if(strcmp(current->key, key) == 0)
-            return current;
-
-        current = current->next;
-    }
-
-    return NULL;
-}
+/********************************************************/
 
-uint32_t bucket_count(bucket_t* self)
+hash_t* hash_init(int size)
 {
-    uint32_t count = 1; //There's at least on element (self)
-
-    bucket_t* current = self;
-
-    //Find the last bucket of the list
-    while(current->next)
-    {
-        count++; //And count one for each
-        current = current->next;
-    }
-
-    return count;
+    hash_t* new_hash_array;
+    xmalloc_set_handler(xmalloc_callback);
+    new_hash_array = xmalloc(sizeof (hash_t));
+    new_hash_array->count = 0;
+    new_hash_array->slots = NULL;
+
+    //Room for the expected elements without growing
+    new_hash_array->buckets_size = size < MIN_CAPACITY ? MIN_CAPACITY : size;
+    new_hash_array->buckets = xmalloc(sizeof (bucket_t*) * new_hash_array->buckets_size);
+
+    int capacity = MIN_CAPACITY;
+    while (capacity < size + size / 2)
+        capacity *= 2;
+    rebuild_slots(new_hash_array, capacity);
+    return new_hash_array;
 }
 
-//Push from the beginning of the arry
-size_t bucket_push_to_array(bucket_t* self, bucket_t** serialised_data)
+void hash_add(hash_t* self, char* key, void* data)
 {
-    uint32_t count = 0;
-    bucket_t* current = self;
-
-    //Goes throught all elements and push them on the array utill the end of the array
-    while(current)
-    {
-        serialised_data[0] = current;
-        count++; //And count one for each
-        current = current->next;
-    }
+    //Get the hash
+    uint32_t hash_val = hash((unsigned char*)key);
 
-    //Return the numer of element pushed
-    return count;
-}
+    //Keep the element already there, like the lookups always did
+    int32_t* slot = find_slot(self, key, hash_val);
+    if(*slot != EMPTY_SLOT)
+        return;
 
-// Deallocate all buckets
-void bucket_free(bucket_t* self)
-{
-    bucket_t* current = self;
-    bucket_t* next;
-
-    //Goes throught all elements and push them on the array utill the end of the array
-    while(current)
+    //Append the new element, the array of buckets stays in insertion order
+    if(self->count >= self->buckets_size)
     {
-        next = current->next;
-        free(current);
-        current = next;
+        self->buckets_size *= 2;
+        self->buckets = realloc(self->buckets, sizeof (bucket_t*) * self->buckets_size);
+        if(self->buckets == NULL)
+        {
+            xmalloc_callback(1);
+            abort();
+        }
     }
-}
-
-/********************************************************/
+    self->buckets[self->count] = bucket_init(key, data, hash_val);
+    *slot = self->count++;
 
-hash_t* hash_init(int size)
-{
-    hash_t* new_hash_array;
-    xmalloc_set_handler(xmalloc_callback);
-    new_hash_array = xmalloc(sizeof (hash_t) + sizeof (bucket_t [size])); // Allocate the struct with its flexible array member
-    memset(new_hash_array, 0, sizeof (hash_t) + sizeof (bucket_t [size])); //Set everything to NULL
-    new_hash_array->size = size;
-    return new_hash_array;
+    //Grow when the table is 3/4 full, so the probe sequences stay short
+    if(self->count * 4 > self->capacity * 3)
+        rebuild_slots(self, self->capacity * 2);
 }
 
-void hash_add(hash_t* self, char* key, void* data)
+bool hash_remove(hash_t* self, char* key)
 {
-    //Create a bucket for holding the data
-    bucket_t* new_bucket = bucket_init(key, data);
+    int32_t* slot = find_slot(self, key, hash((unsigned char*)key));
+    if(*slot == EMPTY_SLOT)
+        return false;
 
-    //Get the hash
-    uint32_t hash_val = hash(key) % self->size;
-    
-    //Get the current content of hash cell
-    bucket_t* current_bucket = self->buckets[hash_val];
-
-    //Add the new bucket if it is currently empty, or append to the end if not empty
-    if(current_bucket == NULL)
-        self->buckets[hash_val] = new_bucket;
-    else
-        bucket_add(self->buckets[hash_val], new_bucket);
+    //Close the gap to keep the order, then index the elements again as they moved
+    int32_t index = *slot;
+    free(self->buckets[index]);
+    memmove(self->buckets + index, self->buckets + index + 1, sizeof (bucket_t*) * (self->count - index - 1));
+    self->count--;
+    rebuild_slots(self, self->capacity);
+    return true;
 }
 
 // Get the data from the hash if it exists, or return NULL
 void* hash_get(hash_t* self, char* key)
 {
-    //Get the hash
-    uint32_t hash_val = hash(key) % self->size;
-    
-    //Get the current content of hash cell
-    bucket_t* current_bucket = self->buckets[hash_val];
-
-    //Hash to an empty slot then the key doesn't exist
-    if(current_bucket == NULL)
-        return NULL;
-
-    //Search the bucket list for a match, will return a NULL if nothing has been found
-    return bucket_find(current_bucket, key)->user_data;
+    void* data;
+    return hash_try_get(self, key, &data) ? data : NULL;
 }
 
 // Try to get the data, if it doesn't exist return false. Data contains the data if it exists
 bool hash_try_get(hash_t* self, char* key, void** data)
 {
-    //Get the hash
-    uint32_t hash_val = hash(key) % self->size;
-    
-    //Get the current content of hash cell
-    bucket_t* current_bucket = self->buckets[hash_val];
-
-    //Hash to an empty slot then the key doesn't exist
-    if(current_bucket == NULL)
-        return false;
-
-    //Search the bucket list for a match, will return a NULL if nothing has been found
-    bucket_t* bucket = bucket_find(current_bucket, key);
-    if(bucket == NULL)
+    int32_t* slot = find_slot(self, key, hash((unsigned char*)key));
+    if(*slot == EMPTY_SLOT)
         return false;
 
-    *data = bucket->user_data;
+    *data = self->buckets[*slot]->user_data;
     return true;
 }
 
@@ -197,48 +123,61 @@ bool hash_check_key(hash_t* self, char* key)
 
 size_t hash_count(hash_t* self)
 {
-    uint32_t count = 0;
-    for(int i = 0; i < self->size; i++)
-    {
-        //Add the numer of elements in one slot
-        if (self->buckets[i])
-            count += bucket_count(self->buckets[i]);
-    }
-    return count;
+    return self->count;
 }
 
 bucket_t** hash_serialise(hash_t* self)
 {
-    bucket_t** serialised_data;
-    uint32_t n_elements = hash_count(self);
-
-    if(n_elements <= 0)
+    if(self->count <= 0)
         return NULL;
 
-    xmalloc_set_handler(xmalloc_callback);
-    serialised_data = xmalloc(sizeof(bucket_t*) * n_elements);
-    
-    uint32_t count = 0;
-    int i = 0;
-    while(count < n_elements)
-    {   
-        if (self->buckets[i] )
-            count += bucket_push_to_array(self->buckets[i], serialised_data + count);
-        i++;
-    }
-
-    return serialised_data;
+    return self->buckets;
 }
 
 // Dealocate all buckets and the hash table
 void hash_free(hash_t* self)
 {
-    for(int i = 0; i < self->size; i++)
+    for(int i = 0; i < self->count; i++)
+        free(self->buckets[i]);
+    free(self->buckets);
+    free(self->slots);
+    free(self);
+}
+
+/********************************************************/
+
+// Slot of a key, or the empty slot where it would be inserted. Linear probing
+static int32_t* find_slot(hash_t* self, char* key, uint32_t hash_val)
+{
+    uint32_t mask = self->capacity - 1;
+    uint32_t i = hash_val & mask;
+    while(self->slots[i] != EMPTY_SLOT)
     {
-        if(self->buckets[i])
-            bucket_free(self->buckets[i]);
+        bucket_t* bucket = self->buckets[self->slots[i]];
+        if(bucket->hash == hash_val && strcmp(bucket->key, key) == 0)
+            break;
+        i = (i + 1) & mask;
+    }
+    return self->slots + i;
+}
+
+// Index all the elements in a new table of slots
+static void rebuild_slots(hash_t* self, int capacity)
+{
+    free(self->slots);
+    xmalloc_set_handler(xmalloc_callback);
+    self->capacity = capacity;
+    self->slots = xmalloc(sizeof (int32_t) * capacity);
+    memset(self->slots, EMPTY_SLOT, sizeof (int32_t) * capacity); //Every byte set gives -1
+
+    uint32_t mask = capacity - 1;
+    for(int32_t i = 0; i < self->count; i++)
+    {
+        uint32_t j = self->buckets[i]->hash & mask;
+        while(self->slots[j] != EMPTY_SLOT)
+            j = (j + 1) & mask;
+        self->slots[j] = i;
     }
-    free(self);
 }
 
 /********************************************************/
@@ -266,4 +205,4 @@ void xmalloc_callback(int err)
         fputs("Malloc returned a NULL pointer\033[0m\n", stderr);
     else
         fputs("Unknown errro\033[0m\n", stderr);
-}
\ No newline at end of file
+}
@@ -2,27 +2,30 @@
 
 #include <stdbool.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 typedef struct bucket_s bucket_t;
 
 struct bucket_s
 {
     void* user_data;
-    bucket_t* previous;
-    bucket_t* next;
+    uint32_t hash; //Hash of the key, compared before the keys and reused when growing
     char key[]; //Flexible array member
 };
 
 typedef struct
 {
-    int size;
-    bucket_t* buckets[]; //Flexible array member
+    int count;          //Number of elements
+    int capacity;       //Number of slots, a power of two
+    int32_t* slots;     //Index of the element of each slot in buckets, -1 if the slot is empty
+    bucket_t** buckets; //Elements in insertion order, without holes
+    int buckets_size;   //Allocated size of buckets
 } hash_t;
 
 /**
- * @brief Initialise a hash array
+ * @brief Initialise a hash array, which grows when it fills up
  * 
- * @param size The size of the hash array
+ * @param size The expected number of elements
  * @return hash_t* Return a pointer to the newly created hash array
  */
 hash_t* hash_init(int size);
@@ -40,12 +43,23 @@ bool hash_try_get(hash_t* self, char* key, void** data);
 /**
  * @brief Add an element to the hash array
  * 
+ * @details If the key is already in the hash array, the element already there is kept
+ *
  * @param self The hash array
  * @param key The key of the element to add
  * @param data The data of the element to add
  */
 void hash_add(hash_t* self, char* key, void* data);
 
+/**
+ * @brief Remove an element from the hash array, keeping the order of the others
+ *
+ * @param self The hash array
+ * @param key The key of the element to remove
+ * @return true If the element was in the hash array
+ */
+bool hash_remove(hash_t* self, char* key);
+
 /**
  * @brief Get an element in the hash array
  * 
@@ -66,10 +80,10 @@ void* hash_get(hash_t* self, char* key);
 bool hash_check_key(hash_t* self, char* key);
 
 /**
- * @brief Convert the hash array to an array
+ * @brief Get the elements of the hash array as an array, in insertion order
  * 
  * @param self The hash array
- * @return bucket_t** Return a pointer to the array of buckets, skipping empty buckets
+ * @return bucket_t** Return a pointer to the array of buckets, valid until the hash array is modified. NULL if it is empty
  */
 bucket_t** hash_serialise(hash_t* self);
 
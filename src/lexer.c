@@ -23,14 +23,14 @@ char *action_parse_char =
 
 char *action_parse_str =
     "    ASS_data_t data;\n"
-    "    data.sVal = malloc(strlen(ASS_text) + 1);\n"
+    "    data.sVal = ASS_malloc(strlen(ASS_text) + 1);\n"
     "    data.type = ASS_DT_STRING;\n"
     "    strcpy(data.sVal, ASS_text);\n"
     "    return data;";
     
 char *action_parse_id =
     "    ASS_data_t data;\n"
-    "    data.sVal = malloc(strlen(ASS_text) + 1);\n"
+    "    data.sVal = ASS_malloc(strlen(ASS_text) + 1);\n"
     "    data.type = ASS_DT_STRING;\n"
     "    strcpy(data.sVal, ASS_text);\n"
     "    return data;";
@@ -56,6 +56,10 @@ int token_id_lookup[] =
 
 darray_t *tokens;
 
+// Range of the enum tokens in the array, their actions are generated separately
+static size_t enum_tokens_start = 0;
+static size_t enum_tokens_end = 0;
+
 static char *name_from_pattern(const char *str);
 
 void lexer_init()
@@ -78,17 +82,21 @@ void lexer_generate()
 
     for (size_t i = 0; i < opcode_count; i++)
     {
-        new_token.id = id++;
-        new_token.pattern = opcodes[i].text_pattern;
-        new_token.name = name_from_pattern(opcodes[i].text_pattern);
-        new_token.action = NULL;
-        new_token.data = &(opcodes[i]); // Store a reference to the original opcode
+        new_token = (token_def_t){
+            .id = id,
+            .token_class = id, // Each mnemonic is its own class
+            .pattern = opcodes[i].text_pattern,
+            .name = name_from_pattern(opcodes[i].text_pattern),
+            .action = NULL,
+            .data = &(opcodes[i])}; // Store a reference to the original opcode
         darray_add(&tokens, new_token);
+        id++;
 
         opcodes[i].token_id = new_token.id;
     }
 
     // Enum tokens
+    enum_tokens_start = tokens->count;
     count = hash_count(enum_array);
     bucket_t **enums = hash_serialise(enum_array);
     for (size_t i = 0; i < count; i++)
@@ -101,97 +109,110 @@ void lexer_generate()
             new_token = (token_def_t){
                 .name = name_from_pattern(((pattern_t *)(current->user_data))->pattern),
                 .id = id,
+                .token_class = ((enumeration_t *)(enums[i]->user_data))->token_id, // Every pattern of an enum is the same operand
                 .pattern = ((pattern_t *)(current->user_data))->pattern,
-                .action = generator_generate_pattern_action((pattern_t *)(current->user_data)),
+                .action = NULL, // Set by lexer_generate_actions
                 .data = (current->user_data)};
             darray_add(&tokens, new_token);
             current = current->next;
             id++;
         }
     }
+    enum_tokens_end = tokens->count;
 
     // Standard tokens
 
     token_id_lookup[eT_COMMENT] = 0; // Comments have priority over everything else
-    new_token = (token_def_t){.name = "COMMENT", .id = 0, .pattern = ";[\\t -~]*", .action = NULL};
+    new_token = (token_def_t){.name = "COMMENT", .id = 0, .token_class = token_id_lookup[eT_COMMENT], .pattern = ";[\\t -~]*", .action = NULL};
     darray_add(&tokens, new_token);
 
     token_id_lookup[eT_ARG_SEPARATOR] = id;
-    new_token = (token_def_t){.name = "ARG_SEPARATOR", .id = id++, .pattern = xmalloc(2), .action = NULL};
+    new_token = (token_def_t){.name = "ARG_SEPARATOR", .id = id++, .token_class = token_id_lookup[eT_ARG_SEPARATOR], .pattern = xmalloc(2), .action = NULL};
     new_token.pattern[0] = parameters.args_separator;
     new_token.pattern[1] = '\0';
     darray_add(&tokens, new_token);
 
     token_id_lookup[eT_NEWLINE] = id;
-    new_token = (token_def_t){.name = "NEWLINE", .id = id++, .pattern = "[\\n\\r\\']", .action = NULL}; // \' is EOF (-1)
+    new_token = (token_def_t){.name = "NEWLINE", .id = id++, .token_class = token_id_lookup[eT_NEWLINE], .pattern = "[\\n\\r\\']", .action = NULL}; // \' is EOF (-1)
     darray_add(&tokens, new_token);
 
     token_id_lookup[eT_WHITESPACE] = id;
-    new_token = (token_def_t){.name = "WHITESPACE", .id = id++, .pattern = "[ \\t]+", .action = NULL};
+    new_token = (token_def_t){.name = "WHITESPACE", .id = id++, .token_class = token_id_lookup[eT_WHITESPACE], .pattern = "[ \\t]+", .action = NULL};
     darray_add(&tokens, new_token);
 
     // TODO: make pattern a parameter
     // Address token
     token_id_lookup[eT_ADDRESS] = id;
-    new_token = (token_def_t){.name = "ADDRESS", .id = id++, .pattern = xmalloc(strlen("0x[0-9a-fA-F]+:")), .action = action_parse_uint};
+    new_token = (token_def_t){.name = "ADDRESS", .id = id++, .token_class = token_id_lookup[eT_ADDRESS], .pattern = xmalloc(strlen("0x[0-9a-fA-F]+:") + 1), .action = action_parse_uint};
     strcpy(new_token.pattern, "0x[0-9a-fA-F]+:");
     new_token.pattern[strlen(new_token.pattern) - 1] = parameters.label_postfix;
     darray_add(&tokens, new_token);
 
     // TODO: make pattern a parameter
     token_id_lookup[eT_LABEL] = id;
-    new_token = (token_def_t){.name = "LABEL", .id = id++, .pattern = xmalloc(strlen("[a-zA-Z_][0-9a-zA-Z_]*:")), .action = action_parse_str};
+    new_token = (token_def_t){.name = "LABEL", .id = id++, .token_class = token_id_lookup[eT_LABEL], .pattern = xmalloc(strlen("[a-zA-Z_][0-9a-zA-Z_]*:") + 1), .action = action_parse_str};
     strcpy(new_token.pattern, "[a-zA-Z_][0-9a-zA-Z_]*:");
     new_token.pattern[strlen(new_token.pattern) - 1] = parameters.label_postfix;
     darray_add(&tokens, new_token);
 
-    //Integer tokens
+    //Integer tokens, the parser only sees the class of the hex one as each kind only differs by its parsing
     token_id_lookup[eT_IMMEDIATE_HEX] = id;
-    new_token = (token_def_t){.name = "IMMEDIATE_HEX", .id = id++, .pattern = "0x[0-9a-fA-F]+", .action = action_parse_int};
+    new_token = (token_def_t){.name = "IMMEDIATE_HEX", .id = id++, .token_class = token_id_lookup[eT_IMMEDIATE_HEX], .pattern = "0x[0-9a-fA-F]+", .action = action_parse_int};
     darray_add(&tokens, new_token);
 
     token_id_lookup[eT_IMMEDIATE_DEC] = id;
-    new_token = (token_def_t){.name = "IMMEDIATE_DEC", .id = id++, .pattern = "\\-?[1-9][0-9]*", .action = action_parse_int};
+    new_token = (token_def_t){.name = "IMMEDIATE_DEC", .id = id++, .token_class = token_id_lookup[eT_IMMEDIATE_HEX], .pattern = "\\-?[1-9][0-9]*", .action = action_parse_int};
     darray_add(&tokens, new_token);
 
     token_id_lookup[eT_IMMEDIATE_OCT] = id;
-    new_token = (token_def_t){.name = "IMMEDIATE_OCT", .id = id++, .pattern = "0[0-7]*", .action = action_parse_int};
+    new_token = (token_def_t){.name = "IMMEDIATE_OCT", .id = id++, .token_class = token_id_lookup[eT_IMMEDIATE_HEX], .pattern = "0[0-7]*", .action = action_parse_int};
     darray_add(&tokens, new_token);
 
     token_id_lookup[eT_IMMEDIATE_BIN] = id;
-    new_token = (token_def_t){.name = "IMMEDIATE_BIN", .id = id++, .pattern = "0b[01]+", .action = action_parse_int};
+    new_token = (token_def_t){.name = "IMMEDIATE_BIN", .id = id++, .token_class = token_id_lookup[eT_IMMEDIATE_HEX], .pattern = "0b[01]+", .action = action_parse_int};
     darray_add(&tokens, new_token);
 
     // character token
     token_id_lookup[eT_IMMEDIATE_CHAR] = id;
-    new_token = (token_def_t){.name = "IMMEDIATE_CHAR", .id = id++, .pattern = "'[ -~]'", .action = action_parse_char};
+    new_token = (token_def_t){.name = "IMMEDIATE_CHAR", .id = id++, .token_class = token_id_lookup[eT_IMMEDIATE_HEX], .pattern = "'[ -~]'", .action = action_parse_char};
     darray_add(&tokens, new_token);
 
     // constant directive token
     token_id_lookup[eT_CONSTANT_DIR] = id;
-    new_token = (token_def_t){.name = "CONSTANT_DIR", .id = id++, .pattern = parameters.constant_dir, .action = NULL};
+    new_token = (token_def_t){.name = "CONSTANT_DIR", .id = id++, .token_class = token_id_lookup[eT_CONSTANT_DIR], .pattern = parameters.constant_dir, .action = NULL};
     darray_add(&tokens, new_token);
 
     // macro directive token
     token_id_lookup[eT_MACRO_DIR] = id;
-    new_token = (token_def_t){.name = "MACRO_DIR", .id = id++, .pattern = parameters.macro_dir, .action = NULL};
+    new_token = (token_def_t){.name = "MACRO_DIR", .id = id++, .token_class = token_id_lookup[eT_MACRO_DIR], .pattern = parameters.macro_dir, .action = NULL};
     darray_add(&tokens, new_token);
 
     token_id_lookup[eT_IDENTIFIER] = id;
-    new_token = (token_def_t){.name = "IDENTIFIER", .id = id++, .pattern = "[a-zA-Z_][a-zA-Z0-9_]*", .action = action_parse_id};
+    new_token = (token_def_t){.name = "IDENTIFIER", .id = id++, .token_class = token_id_lookup[eT_IDENTIFIER], .pattern = "[a-zA-Z_][a-zA-Z0-9_]*", .action = action_parse_id};
     darray_add(&tokens, new_token);
 
     fail_debug("****Tokens****");
     for (size_t i = 0; i < tokens->count; i++)
     {
         new_token = *((token_def_t *)darray_get_ptr(&tokens, i));
-        fail_debug("  Name : %s | Id : %i | Pattern : %s", new_token.name, new_token.id, new_token.pattern);
+        fail_debug("  Name : %s | Id : %i | Class : %i | Pattern : %s", new_token.name, new_token.id, new_token.token_class, new_token.pattern);
     }
     fail_debug("**************");
+}
 
+void lexer_generate_dfa()
+{
     generator_generate_lexer(tokens->count, (token_def_t *)tokens->element_list);
 }
 
+void lexer_generate_actions()
+{
+    // Only the action field is written, the lexer DFA can be built from the other fields at the same time
+    token_def_t *token_list = darray_get_ptr(&tokens, 0);
+    for (size_t i = enum_tokens_start; i < enum_tokens_end; i++)
+        token_list[i].action = generator_generate_pattern_action((pattern_t *)token_list[i].data);
+}
+
 char *name_from_pattern(const char *str)
 {
     int len = strlen(str);
@@ -38,7 +38,19 @@ extern darray_t* tokens;
 void lexer_init();
 
 /**
- * @brief Generate the the lexer from the list of tokens
+ * @brief Generate the list of tokens and assign their ids
  * 
  */
-void lexer_generate();
\ No newline at end of file
+void lexer_generate();
+
+/**
+ * @brief Generate the lexer DFA from the list of tokens
+ *
+ */
+void lexer_generate_dfa();
+
+/**
+ * @brief Generate the actions of the enum tokens. Can run at the same time as lexer_generate_dfa
+ *
+ */
+void lexer_generate_actions();
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <signal.h>
 #include <string.h>
 #include <errno.h>
@@ -21,6 +22,10 @@
 #include "lexer.h"
 #include "parser.h"
 #include "parser_gen.h"
+#include "stats.h"
+#include "cache.h"
+#include "task_graph.h"
+#include "profile.h"
 
 char const *const help_message =
     "Usage: %s [OPTION]... -o OUTPUT_FILE INTPUT_FILES\n"
@@ -29,13 +34,37 @@ char const *const help_message =
     "\n"
     "Options:\n"
     "  -o <FILE>   set the output file\n"
+    "  -l <FILE>   emit a library without main, declared in the header FILE\n"
+    "  -d <DIR>    write the assembler to the existing directory DIR as several\n"
+    "              translation units with a Makefile, instead of a single file\n"
     "  -h          display this help and exit\n"
     "  -V          output version information and exit\n"
     "  -v          set verbosity level to INFOS\n"
     "  -vv         set verbosity level to DETAILS\n"
     "  -W          suppress warnings by setting verbosity level to ERRORS\n"
     "  -s          silent mode\n"
-    "  -C          suppress colours\n";
+    "  -C          suppress colours\n"
+    "  --stats[=json]  report the time, peak memory and state machine sizes of each phase on stderr\n"
+    "  --encoder=<table|functions>\n"
+    "              encode the opcodes with shared field tables (default), or with one function each\n"
+    "  --shards=<N>  with -d, deal the actions to N translation units (default 4)\n"
+    "  --cache-dir=<DIR>\n"
+    "              reuse the state machines, and the output file without -d and -l,\n"
+    "              from a previous run with the same inputs, cached in DIR\n"
+    "  --jobs=<N>  build the lexer and the parser on N threads (default: number of CPUs)\n"
+    "  --profile-in=<FILE>\n"
+    "              order the states and transitions of the state machines from the counts\n"
+    "              written by the assembler with --profile-out, can be repeated\n";
+
+static struct option const long_options[] = {
+    {"stats", optional_argument, NULL, 'S'},
+    {"encoder", required_argument, NULL, 'E'},
+    {"shards", required_argument, NULL, 'N'},
+    {"cache-dir", required_argument, NULL, 'K'},
+    {"jobs", required_argument, NULL, 'J'},
+    {"profile-in", required_argument, NULL, 'P'},
+    {NULL, 0, NULL, 0},
+};
 
 char const *const version_message =
     "ass (Assembly Syntax Synthesiser) %i.%i.%i, build %i-%i\n"
@@ -47,12 +76,23 @@ char const *const version_message =
     "This is free software, and you are welcome to redistribute it\n"
     "under certain conditions; refer to the license for details.\n";
 
+// Tasks of the generation of the lexer and the parser
+static void token_ids_task(void *argument);
+static void rules_task(void *argument);
+static void lexer_dfa_task(void *argument);
+static void parser_dfa_task(void *argument);
+static void actions_task(void *argument);
+
 int main(int argc, char **argv)
 {
     // File descriptor for the output file
     // TODO: more meaningful naming
     FILE *fd;
     char *output_file = NULL;
+    char *header_file = NULL;
+    char *output_dir = NULL;
+    int shards = 4;
+    bool encoder_tables = true;
     char *file_list[argc];
     int file_count = 0;
     int opt;
@@ -60,7 +100,7 @@ int main(int argc, char **argv)
 
     // Parse options
     fail_show_loc(false);
-    while ((opt = getopt(argc, argv, ":hVsWCvo:")) != -1)
+    while ((opt = getopt_long(argc, argv, ":hVsWCvo:l:d:", long_options, NULL)) != -1)
     {
         switch (opt)
         {
@@ -96,6 +136,51 @@ int main(int argc, char **argv)
             output_file = optarg;
             fail_debug("Output file is %s", output_file);
             break;
+        case 'l': // Library header file
+            if (header_file != NULL)
+                fail_warning("Header file path overriden.");
+            header_file = optarg;
+            fail_debug("Header file is %s", header_file);
+            break;
+        case 'd': // Output directory
+            if (output_dir != NULL)
+                fail_warning("Output directory path overriden.");
+            output_dir = optarg;
+            fail_debug("Output directory is %s", output_dir);
+            break;
+        case 'S': // Statistics
+            if (optarg == NULL || strcmp(optarg, "text") == 0)
+                stats_enable(false);
+            else if (strcmp(optarg, "json") == 0)
+                stats_enable(true);
+            else
+                fail_error("Unknown statistics format '%s'", optarg);
+            break;
+        case 'E': // Opcode encoder
+            if (strcmp(optarg, "table") == 0)
+                encoder_tables = true;
+            else if (strcmp(optarg, "functions") == 0)
+                encoder_tables = false;
+            else
+                fail_error("Unknown encoder '%s'", optarg);
+            generator_set_encoder_tables(encoder_tables);
+            break;
+        case 'N': // Number of action units
+            shards = atoi(optarg);
+            if (shards < 1)
+                fail_error("The number of shards must be at least 1, got '%s'", optarg);
+            break;
+        case 'K': // Cache directory
+            cache_set_directory(optarg);
+            break;
+        case 'J': // Number of threads
+            if (atoi(optarg) < 1)
+                fail_error("The number of jobs must be at least 1, got '%s'", optarg);
+            task_set_jobs(atoi(optarg));
+            break;
+        case 'P': // Profile of the state machines
+            profile_load(optarg);
+            break;
         case ':':
             fail_error("Option '%c' expects an argument", optopt);
             break;
@@ -125,8 +210,10 @@ int main(int argc, char **argv)
         exit(EXIT_FAILURE);
     }
 
-    // Open the output stream, catching errors earlier
-    if (output_file == NULL)
+    // Open the output stream, catching errors earlier. A directory is filled at the end
+    if (output_dir != NULL)
+        fd = NULL;
+    else if (output_file == NULL)
         fd = stdout;
     else
         fd = fopen(output_file, "w");
@@ -138,9 +225,16 @@ int main(int argc, char **argv)
     command_init();
     param_init();
 
+    // The specification is hashed before the parser consumes it
+    uint64_t output_key = CACHE_HASH_INIT;
+    if (cache_enabled())
+        output_key = cache_hash_input(cache_hash_version(output_key), file_count, file_list);
+
     // Parse the file and generate all data
     fail_debug("Parsing the file%s", file_count == 1 ? "" : "s");
+    stats_begin("parse_file");
     parse_file(file_count, file_list);
+    stats_end();
 
     // Check for previous errors and exit if an error occured during parsing
     fail_show_loc(false);
@@ -151,17 +245,40 @@ int main(int argc, char **argv)
     }
 
     // Fill parameters that have not been set
+    stats_begin("param_fill_unset");
     param_fill_unset();
+    stats_end();
 
-    // Generate the lexer
-    fail_debug("Generating the lexer");
-    lexer_init();
-    lexer_generate();
+    // Reuse the output of a previous run with the same inputs. The lexer and parser caches handle the other modes
+    bool cache_output = cache_enabled() && output_dir == NULL && header_file == NULL;
+    if (cache_output)
+    {
+        output_key = cache_hash_parameters(output_key);
+        output_key = generate_skeleton_hash(output_key);
+        output_key = cache_hash(output_key, &encoder_tables, sizeof(encoder_tables));
+        output_key = profile_hash(output_key);
+        if (cache_load_output(output_key, fd))
+        {
+            fclose(fd);
+            stats_print(stderr);
+            fail_info("Success, from the cache");
+            exit(fail_get_error_count() == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+    }
 
-    // Generate the parser
-    fail_debug("Generating the parser");
-    parser_init();
-    parser_generate();
+    // Generate the lexer and the parser. The DFAs and the actions only need the token ids and the rules
+    fail_debug("Generating the lexer and the parser");
+    task_graph_t *graph = task_graph_init();
+    int token_ids = task_graph_add(graph, token_ids_task, NULL);
+    int rules = task_graph_add(graph, rules_task, NULL);
+    int lexer_dfa = task_graph_add(graph, lexer_dfa_task, NULL);
+    int parser_dfa = task_graph_add(graph, parser_dfa_task, NULL);
+    int actions = task_graph_add(graph, actions_task, NULL);
+    task_graph_depends(graph, rules, token_ids);
+    task_graph_depends(graph, lexer_dfa, token_ids);
+    task_graph_depends(graph, parser_dfa, rules);
+    task_graph_depends(graph, actions, rules);
+    task_graph_run(graph);
 
     // Check for previous errors and exit if an error occured during dfa generation
     if (fail_get_error_count() != 0)
@@ -171,9 +288,37 @@ int main(int argc, char **argv)
     }
 
     // Generate the file
-    generator_set_file_descriptor(fd);
-    generate(fd);
-    fclose(fd);
+    generator_set_library_header(header_file);
+    stats_begin("generate");
+    if (output_dir != NULL)
+    {
+        generate_directory(output_dir, shards);
+    }
+    else
+    {
+        generator_set_file_descriptor(fd);
+        generate(fd);
+        fclose(fd);
+        if (cache_output && output_file != NULL && fail_get_error_count() == 0)
+            cache_store_output(output_key, output_file);
+    }
+    stats_output_size(generator_flushed_size());
+    stats_end();
+
+    // Generate the header declaring the library API
+    if (header_file != NULL)
+    {
+        fd = fopen(header_file, "w");
+        if (fd == NULL)
+        {
+            fail_error("%s (%s)", strerror(errno), header_file);
+            exit(EXIT_FAILURE);
+        }
+        generator_set_file_descriptor(fd);
+        generate_header(fd);
+        fclose(fd);
+    }
+    profile_free();
     
     // Check for previous errors and exit if an error occured during generation
     if (fail_get_error_count() != 0)
@@ -183,7 +328,46 @@ int main(int argc, char **argv)
     }
     else
     {
+        stats_print(stderr);
         fail_info("Success");
         exit(EXIT_SUCCESS);
     }
-}
\ No newline at end of file
+}
+
+static void token_ids_task(void *argument)
+{
+    stats_begin("lexer_generate");
+    lexer_init();
+    lexer_generate();
+    stats_end();
+}
+
+static void rules_task(void *argument)
+{
+    stats_begin("parser_generate");
+    parser_init();
+    parser_generate();
+    stats_end();
+}
+
+static void lexer_dfa_task(void *argument)
+{
+    stats_begin("lexer DFA");
+    lexer_generate_dfa();
+    stats_end();
+}
+
+static void parser_dfa_task(void *argument)
+{
+    stats_begin("parser DFA");
+    parser_generate_dfa();
+    stats_end();
+}
+
+static void actions_task(void *argument)
+{
+    stats_begin("actions");
+    lexer_generate_actions();
+    parser_generate_actions();
+    stats_end();
+}
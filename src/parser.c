@@ -1,23 +1,41 @@
 #include "parser.h"
 
 #include "failure.h"
+#include "task_graph.h"
+
+// Arguments of the construction of the sub-NFAs
+typedef struct
+{
+    const rule_def_t **rules;
+    state_machine_t *nfas;
+} rule_nfas_t;
+
+static void rule_nfa_task(int index, void *context)
+{
+    rule_nfas_t *arrays = context;
+    arrays->nfas[index] = parser_rule_to_nfa(arrays->rules[index]);
+}
 
 state_machine_t parser_arrays_to_nfa(int count, const rule_def_t **rules)
 {
-    state_machine_t new_state_machine;
     state_machine_t merged_state_machine;
 
-    // Generate the first fsm
-    merged_state_machine = parser_rule_to_nfa(rules[0]);
+    // The rules are independent, but the merge renumbers the states so it stays in order
+    rule_nfas_t arrays = {.rules = rules, .nfas = xmalloc(sizeof(state_machine_t) * count)};
+    task_parallel_for(count, rule_nfa_task, &arrays);
 
+    merged_state_machine = arrays.nfas[0];
     for (size_t i = 1; i < count; i++)
     {
-        // Generate a new state machine and reduce if possible
-        new_state_machine = parser_rule_to_nfa(rules[i]);
-        merged_state_machine = state_machine_merge(&merged_state_machine, &new_state_machine);
+        // Merge the next state machine and reduce if possible, the merge copies both of them
+        state_machine_t previous = merged_state_machine;
+        merged_state_machine = state_machine_merge(&previous, &(arrays.nfas[i]));
+        state_machine_destroy(&previous);
+        state_machine_destroy(&(arrays.nfas[i]));
         state_machine_reduce(&merged_state_machine);
     }
 
+    free(arrays.nfas);
     return merged_state_machine;
 }
 
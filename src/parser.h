@@ -10,6 +10,7 @@ typedef struct
     int id;
     char *name;
     char* action;
+    void *data; // Opcode the rule encodes, NULL for the other rules
     int count;
     int tokens[];
 } rule_def_t;
@@ -32,6 +32,10 @@ char *action_constant =
 
 darray_t *rule_list_tint;
 
+// Rules of the parser, the first ones are the opcodes in order
+static rule_def_t **rules = NULL;
+static int n_rules = 0;
+
 void parser_init()
 {
     rule_list_tint = darray_init(sizeof(int));
@@ -39,88 +43,61 @@ void parser_init()
 
 void parser_generate()
 {
-    int n_rules = opcode_array->count + 5;
+    n_rules = opcode_array->count + 5;
 
     // Generate the rules for the parser
     int opcode_count = opcode_array->count;
     opcode_t *opcodes = darray_get_ptr(&opcode_array, 0);
-    const rule_def_t **rules = xmalloc(sizeof(rule_def_t) * n_rules);
+    rules = xmalloc(sizeof(rule_def_t *) * n_rules);
     // Generate one rule per opcode
     for (size_t i = 0; i < opcode_count; i++)
     {
         // Clear the list of token
-        darray_empty(&rule_list_tint);
+        darray_clear(&rule_list_tint);
 
         // Add the token for the mnemonic
         darray_add(&rule_list_tint, opcodes[i].token_id);
 
-        // Generate the parameter order
-        bool found = true;
-        for (size_t j = 0; found; j++)
+        // Generate the parameter order, stop at the first missing argument
+        bit_pattern_t const *format = opcodes[i].format;
+        for (size_t j = 0; j < format->argument_count && format->mnemonic_order[j] >= 0; j++)
         {
-            linked_list_t *current = opcodes[i].bit_pattern;
-            while (current != NULL)
+            bit_elem_t const *bit_elem = &format->elems[format->mnemonic_order[j]];
+            int token_id;
+            switch (bit_elem->type)
+            {
+            case eBP_ID:
+                darray_add(&rule_list_tint, token_id_lookup[eT_IDENTIFIER]);
+                break;
+            case eBP_IMMEDIATE:
+                // Open a set, every kind of immediate is in the class of the hexadecimal ones
+                token_id = -(int)'[';
+                darray_add(&rule_list_tint, token_id);
+                darray_add(&rule_list_tint, token_id_lookup[eT_IMMEDIATE_HEX]);
+                darray_add(&rule_list_tint, token_id_lookup[eT_IDENTIFIER]);
+                // Close the set
+                token_id = -(int)']';
+                darray_add(&rule_list_tint, token_id);
+                break;
+            case eBP_LABEL_ABS:
+                darray_add(&rule_list_tint, token_id_lookup[eT_IDENTIFIER]); // TODO: also accept absolute adresses
+                break;
+            case eBP_LABEL_REL:
+                darray_add(&rule_list_tint, token_id_lookup[eT_IDENTIFIER]); // TODO: also accept absolute adresses
+                break;
+            case eBP_ENUM:
             {
-                bit_elem_t *bit_elem = (bit_elem_t *)current->user_data;
-                if (bit_elem->index_mnemonic == j)
-                {
-                    int token_id;
-                    switch (bit_elem->type)
-                    {
-                    case eBP_ID:
-                        darray_add(&rule_list_tint, token_id_lookup[eT_IDENTIFIER]);
-                        break;
-                    case eBP_IMMEDIATE:
-                        // Open a set
-                        token_id = -(int)'[';
-                        darray_add(&rule_list_tint, token_id);
-                        darray_add(&rule_list_tint, token_id_lookup[eT_IMMEDIATE_HEX]);
-                        darray_add(&rule_list_tint, token_id_lookup[eT_IMMEDIATE_DEC]);
-                        darray_add(&rule_list_tint, token_id_lookup[eT_IMMEDIATE_OCT]);
-                        darray_add(&rule_list_tint, token_id_lookup[eT_IMMEDIATE_BIN]);
-                        darray_add(&rule_list_tint, token_id_lookup[eT_IMMEDIATE_CHAR]);
-                        darray_add(&rule_list_tint, token_id_lookup[eT_IDENTIFIER]);
-                        // Close the set
-                        token_id = -(int)']';
-                        darray_add(&rule_list_tint, token_id);
-                        break;
-                    case eBP_LABEL_ABS:
-                        darray_add(&rule_list_tint, token_id_lookup[eT_IDENTIFIER]); // TODO: also accept absolute adresses
-                        break;
-                    case eBP_LABEL_REL:
-                        darray_add(&rule_list_tint, token_id_lookup[eT_IDENTIFIER]); // TODO: also accept absolute adresses
-                        break;
-                    case eBP_ENUM:
-                        // Open a set
-                        token_id = -(int)'[';
-                        darray_add(&rule_list_tint, token_id);
-                        // TODO: store a ptr to the enum in the bit_elem instead of a copy
-                        enumeration_t *enumeration = ((enumeration_t *)hash_get(enum_array, ((enumeration_t *)(bit_elem->data))->name));
-                        linked_list_t *current_pattern = enumeration->pattern_list;
-                        token_id = enumeration->token_id;
-                        while (current_pattern != NULL)
-                        {
-                            darray_add(&rule_list_tint, token_id);
-                            current_pattern = current_pattern->next;
-                            token_id++;
-                        }
-                        // Close the set
-                        token_id = -(int)']';
-                        darray_add(&rule_list_tint, token_id);
-                        break;
-                    default:
-                        fail_error("Undefined mnemonic type for the opcode '%s' (arg %i)", opcodes[i].text_pattern, j);
-                        exit(EXIT_FAILURE);
-                    }
-                    break;
-                }
-                current = current->next;
+                // The patterns of an enum are all in the class of its first token
+                darray_add(&rule_list_tint, bit_elem->enumeration->token_id);
+                break;
+            }
+            default:
+                fail_error("Undefined mnemonic type for the opcode '%s' (arg %i)", opcodes[i].text_pattern, j);
+                exit(EXIT_FAILURE);
             }
-            found = (current != NULL);
 
             // Add an argument separator between each argument
-            if (found)
-                darray_add(&rule_list_tint, token_id_lookup[eT_ARG_SEPARATOR]);
+            darray_add(&rule_list_tint, token_id_lookup[eT_ARG_SEPARATOR]);
         }
 
         // Remove all trailing argument separator
@@ -147,34 +124,30 @@ void parser_generate()
         rule_def_t *new_rule = xmalloc(sizeof(rule_def_t) + rule_list_tint->element_size * rule_list_tint->count);
         new_rule->id = i;
         new_rule->count = rule_list_tint->count;
-        new_rule->action = generator_generate_opcode_action(opcodes[i]);
+        new_rule->action = NULL; // Set by parser_generate_actions
+        new_rule->data = &(opcodes[i]); // Store a reference to the original opcode
         new_rule->name = ((token_def_t *)darray_get_ptr(&tokens, i))->name;
         memcpy(&(new_rule->tokens), darray_get_ptr(&rule_list_tint, 0), rule_list_tint->count * rule_list_tint->element_size);
         rules[i] = new_rule;
-        fail_debug("Generated rule for '%s' with %i tokens. Action rule : \n%s", new_rule->name, new_rule->count, new_rule->action);
+        fail_debug("Generated rule for '%s' with %i tokens", new_rule->name, new_rule->count);
     }
 
     int x = 0;
     rule_def_t *new_rule;
 
-    new_rule = xmalloc(sizeof(rule_def_t) + 13 * sizeof(int));
+    new_rule = xmalloc(sizeof(rule_def_t) + 7 * sizeof(int));
     new_rule->id = opcode_count + x;
-    new_rule->count = 13;
+    new_rule->count = 7;
     new_rule->name = "constant";
     new_rule->action = action_constant;
+    new_rule->data = NULL;
     new_rule->tokens[0] = token_id_lookup[eT_CONSTANT_DIR];
     new_rule->tokens[1] = token_id_lookup[eT_IDENTIFIER];
-    new_rule->tokens[2] = -(int)'['; //Open a set
-    new_rule->tokens[3] = token_id_lookup[eT_IMMEDIATE_HEX];
-    new_rule->tokens[4] = token_id_lookup[eT_IMMEDIATE_DEC];
-    new_rule->tokens[5] = token_id_lookup[eT_IMMEDIATE_OCT];
-    new_rule->tokens[6] = token_id_lookup[eT_IMMEDIATE_BIN];
-    new_rule->tokens[7] = token_id_lookup[eT_IMMEDIATE_CHAR];
-    new_rule->tokens[8] = -(int)']'; //Close the set
-    new_rule->tokens[9] = -(int)'['; //Open a set
-    new_rule->tokens[10] = token_id_lookup[eT_NEWLINE];
-    new_rule->tokens[11] = token_id_lookup[eT_COMMENT];
-    new_rule->tokens[12] = -(int)']'; //Close the set
+    new_rule->tokens[2] = token_id_lookup[eT_IMMEDIATE_HEX]; // Class of all the immediates
+    new_rule->tokens[3] = -(int)'['; //Open a set
+    new_rule->tokens[4] = token_id_lookup[eT_NEWLINE];
+    new_rule->tokens[5] = token_id_lookup[eT_COMMENT];
+    new_rule->tokens[6] = -(int)']'; //Close the set
     rules[opcode_count + x] = new_rule;
     x++;
 
@@ -183,6 +156,7 @@ void parser_generate()
     new_rule->count = 1;
     new_rule->name = "single_comment";
     new_rule->action = NULL;
+    new_rule->data = NULL;
     new_rule->tokens[0] = token_id_lookup[eT_COMMENT];
     rules[opcode_count + x] = new_rule;
     x++;
@@ -192,6 +166,7 @@ void parser_generate()
     new_rule->count = 1;
     new_rule->name = "single_newline";
     new_rule->action = NULL;
+    new_rule->data = NULL;
     new_rule->tokens[0] = token_id_lookup[eT_NEWLINE];
     rules[opcode_count + x] = new_rule;
     x++;
@@ -201,6 +176,7 @@ void parser_generate()
     new_rule->count = 1;
     new_rule->name = "label";
     new_rule->action = action_label;
+    new_rule->data = NULL;
     new_rule->tokens[0] = token_id_lookup[eT_LABEL];
     rules[opcode_count + x] = new_rule;
     x++;
@@ -210,11 +186,26 @@ void parser_generate()
     new_rule->count = 1;
     new_rule->name = "address";
     new_rule->action = action_address;
+    new_rule->data = NULL;
     new_rule->tokens[0] = token_id_lookup[eT_ADDRESS];
     rules[opcode_count + x] = new_rule;
     x++;
+}
 
-    generator_generate_parser(n_rules, rules);
+void parser_generate_dfa()
+{
+    generator_generate_parser(n_rules, (const rule_def_t **)rules);
+}
+
+void parser_generate_actions()
+{
+    // One rule per opcode, in the same order
+    opcode_t *opcodes = darray_get_ptr(&opcode_array, 0);
+    for (size_t i = 0; i < opcode_array->count; i++)
+    {
+        rules[i]->action = generator_generate_opcode_action(opcodes[i]);
+        fail_debug("Action of the rule '%s' : \n%s", rules[i]->name, rules[i]->action);
+    }
 }
 
 char *name_from_pattern(const char *str)
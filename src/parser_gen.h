@@ -10,7 +10,19 @@
 void parser_init();
 
 /**
- * @brief Generate the parser from the list of rule
+ * @brief Generate the list of rules from the opcodes and the token ids
  * 
  */
-void parser_generate();
\ No newline at end of file
+void parser_generate();
+
+/**
+ * @brief Generate the parser DFA from the list of rules
+ *
+ */
+void parser_generate_dfa();
+
+/**
+ * @brief Generate the actions of the opcode rules. Can run at the same time as parser_generate_dfa
+ *
+ */
+void parser_generate_actions();
\ No newline at end of file
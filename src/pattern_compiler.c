@@ -5,6 +5,7 @@
 // Generate a state machine matching the provided sequence
 state_machine_t pattern_compiler(size_t count, const int *sequence, int output)
 {
+    arena_t *arena = state_machine_arena_begin();
     state_machine_t new_state_machine = state_machine_init();
 
     state_t *current_state = darray_get_ptr(&(new_state_machine.states_tstate), 0); // State to be processed
@@ -35,7 +36,7 @@ state_machine_t pattern_compiler(size_t count, const int *sequence, int output)
     {
         // Empty the set unless we are currently processing a set
         if (!parsing_set)
-            darray_empty(&set);
+            darray_clear(&set);
 
         // Negative values are control characters, except -1 which is EOF
         if (sequence[i] < -1)
@@ -203,5 +204,7 @@ state_machine_t pattern_compiler(size_t count, const int *sequence, int output)
         current_state->output = output;
     }
 
+    darray_destroy(&set);
+    state_machine_arena_end(&new_state_machine, arena);
     return new_state_machine;
 }
\ No newline at end of file
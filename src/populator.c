@@ -1,135 +1,213 @@
 #include "populator.h"
 
+#include <errno.h>
+
 #include "failure.h"
-#include "generated/skeleton.h"
+#include "cache.h"
 
-#define MAX_NAME_LENGHT 64
+// Replace patterns, in the order of markers.def
+enum
+{
+#define MARKER(name) MARKER_##name,
+#include "skeletons/markers.def"
+#undef MARKER
+};
 
-// Automatically add "generator_" before the name
-#define register_function(name) hash_add(function_table, #name, generator_##name)
+// The embedded skeletons and the index of their patterns
+#include "generated/skeleton.h"
+#include "generated/skeleton_header.h"
+#include "generated/skeleton_shared.h"
 
 typedef void (*callable_t)(int);
-hash_t *function_table;
+
+// Whether the shared header has its own file
+static bool shared_header_file = false;
+
+// Include the shared header, or copy it in place when everything is in a single file
+static void generator_shared_header(int indent);
+
+// Generator function of each replace pattern
+static callable_t const callbacks[] = {
+#define MARKER(name) [MARKER_##name] = generator_##name,
+#include "skeletons/markers.def"
+#undef MARKER
+};
+
+// Emit a skeleton from its index, alternating literal segments and generator functions
+static void populate(skeleton_segment_t const *segments, unsigned char const *skeleton, unsigned int skeleton_len);
+
+// Open a file of the output directory and direct the generator to it
+static FILE *open_unit(char const *dir, char const *name);
+
+// Write what has been generated for a file of the output directory and close it
+static bool close_unit(FILE *fd);
+
+// Write the first lines of a translation unit other than the core
+static void unit_preamble(void);
 
 void generate(FILE *fd)
 {
-    int wait_index = 3;
-
-    function_table = hash_init(64);
-
-    register_function(default_macros);
-    register_function(custom_outputs_selection);
-    register_function(custom_outputs_switch);
-    register_function(outputs_enum);
-    register_function(custom_outputs_function);
-    register_function(startup);
-    register_function(custom_code);
-    register_function(help_message);
-    register_function(version_message);
-    register_function(notice);
-    register_function(parameters);
-    register_function(data_union);
-    register_function(data_types);
-    register_function(lexer_actions);
-    register_function(lexer_action_list);
-    register_function(lexer_switch);
-    register_function(parser_actions);
-    register_function(parser_action_list);
-    register_function(parser_switch);
-    register_function(token_enum);
-    register_function(token_names);
-
-    int line = 1;
-    int column = 1;
-
-    char name_buff[MAX_NAME_LENGHT];
-    // Sliding buffer
-    char sl_buff[4];
-    for (size_t i = 0; i < SKELETON_LEN; i++)
+    shared_header_file = false;
+    generator_set_file_descriptor(fd);
+    populate(SKELETON_SEGMENTS, SKELETON, SKELETON_LEN);
+    if (!generator_flush())
+        fail_error("%s (while writing the output file)", strerror(errno));
+}
+
+bool generate_directory(char const *dir, int shards)
+{
+    generator_set_split(true);
+    shared_header_file = true;
+
+    // The actions stay in the core when the user code can't be moved out of it
+    if (!generator_split_user_code())
+        shards = 0;
+
+    char const *units[4 + shards];
+    char shard_names[shards + 1][24];
+    int count = 0;
+    FILE *fd;
+
+    if ((fd = open_unit(dir, "assembler.h")) == NULL)
+        return false;
+    populate(SKELETON_SHARED_SEGMENTS, SKELETON_SHARED, SKELETON_SHARED_LEN);
+    if (!close_unit(fd))
+        return false;
+
+    if ((fd = open_unit(dir, "core.c")) == NULL)
+        return false;
+    populate(SKELETON_SEGMENTS, SKELETON, SKELETON_LEN);
+    if (!close_unit(fd))
+        return false;
+    units[count++] = "core";
+
+    if ((fd = open_unit(dir, "lexer.c")) == NULL)
+        return false;
+    unit_preamble();
+    generator_lexer_unit();
+    if (!close_unit(fd))
+        return false;
+    units[count++] = "lexer";
+
+    if ((fd = open_unit(dir, "parser.c")) == NULL)
+        return false;
+    unit_preamble();
+    generator_parser_unit();
+    if (!close_unit(fd))
+        return false;
+    units[count++] = "parser";
+
+    if (generator_split_user_code())
+    {
+        if ((fd = open_unit(dir, "outputs.c")) == NULL)
+            return false;
+        unit_preamble();
+        generator_outputs_unit();
+        if (!close_unit(fd))
+            return false;
+        units[count++] = "outputs";
+    }
+
+    for (int i = 0; i < shards; i++)
+    {
+        snprintf(shard_names[i], sizeof(shard_names[i]), "actions_%i", i);
+        char file_name[32];
+        snprintf(file_name, sizeof(file_name), "%s.c", shard_names[i]);
+
+        if ((fd = open_unit(dir, file_name)) == NULL)
+            return false;
+        unit_preamble();
+        generator_actions_unit(i, shards);
+        if (!close_unit(fd))
+            return false;
+        units[count++] = shard_names[i];
+    }
+
+    if ((fd = open_unit(dir, "Makefile")) == NULL)
+        return false;
+    generator_makefile(units, count);
+    if (!close_unit(fd))
+        return false;
+
+    generator_set_split(false);
+    return true;
+}
+
+void generate_header(FILE *fd)
+{
+    generator_set_file_descriptor(fd);
+    populate(SKELETON_HEADER_SEGMENTS, SKELETON_HEADER, SKELETON_HEADER_LEN);
+    if (!generator_flush())
+        fail_error("%s (while writing the header file)", strerror(errno));
+}
+
+uint64_t generate_skeleton_hash(uint64_t hash)
+{
+    hash = cache_hash(hash, SKELETON, SKELETON_LEN);
+    hash = cache_hash(hash, SKELETON_HEADER, SKELETON_HEADER_LEN);
+    return cache_hash(hash, SKELETON_SHARED, SKELETON_SHARED_LEN);
+}
+
+static void generator_shared_header(int indent)
+{
+    if (shared_header_file)
+    {
+        generator_notice(indent);
+        char const *include = "\n#include \"assembler.h\"\n";
+        generator_emit(include, strlen(include));
+    }
+    else
+    {
+        populate(SKELETON_SHARED_SEGMENTS, SKELETON_SHARED, SKELETON_SHARED_LEN);
+    }
+}
+
+static FILE *open_unit(char const *dir, char const *name)
+{
+    char path[strlen(dir) + strlen(name) + 2];
+    sprintf(path, "%s/%s", dir, name);
+
+    FILE *fd = fopen(path, "w");
+    if (fd == NULL)
+    {
+        fail_error("%s (%s)", strerror(errno), path);
+        return NULL;
+    }
+
+    generator_set_file_descriptor(fd);
+    return fd;
+}
+
+static bool close_unit(FILE *fd)
+{
+    bool written = generator_flush();
+    if (fclose(fd) != 0 || !written)
+    {
+        fail_error("%s (while writing the output directory)", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+static void unit_preamble(void)
+{
+    generator_notice(0);
+    char const *include = "\n#include \"assembler.h\"\n\n";
+    generator_emit(include, strlen(include));
+}
+
+static void populate(skeleton_segment_t const *segments, unsigned char const *skeleton, unsigned int skeleton_len)
+{
+    char const *text = (char const *)skeleton;
+
+    skeleton_segment_t const *segment = segments;
+    for (; segment->marker >= 0; segment++)
     {
-        sl_buff[0] = sl_buff[1];
-        sl_buff[1] = sl_buff[2];
-        sl_buff[2] = sl_buff[3];
-        sl_buff[3] = SKELETON[i];
-
-        if (SKELETON[i] == '\n')
-        {
-            column = 1;
-            line++;
-        }
-        else
-        {
-            column++;
-        }
-
-        // If we match a replace pattern, read the target name
-        if (sl_buff[0] == '/' && sl_buff[1] == '*' && sl_buff[2] == '!' && sl_buff[3] == '!')
-        {
-            // Skip leading spaces
-            int index = 0;
-            char c = SKELETON[++i];
-            while (isspace(c))
-            {
-                if (i == SKELETON_LEN - 1 || c == '\n')
-                {
-                    fail_error("Line %i, col %i : Syntax error in the skelton file, no name in replace pattern", line, column);
-                    fail_error("Please report the issue to https://github.com/bourquenoud/ass");
-                    abort();
-                }
-                c = SKELETON[++i];
-            }
-
-            // Read the name until we match an invalid character
-            while (c >= 'a' && c <= 'z' || c >= 'A' && c <= 'Z' || c >= '0' && c <= '9' || c == '_')
-            {
-                name_buff[index++] = c;
-                if (i == SKELETON_LEN - 1 || index >= MAX_NAME_LENGHT - 1 || c == '\n')
-                {
-                    fail_error("Line %i, col %i : Syntax error in the skelton file, replace pattern never closed or name too long", line, column);
-                    fail_error("Please report the issue to https://github.com/bourquenoud/ass");
-                    abort();
-                }
-                c = SKELETON[++i];
-            }
-            name_buff[index] = '\0';
-
-            // Read until we match the closing pattern
-            while (sl_buff[0] != '!' || sl_buff[1] != '!' || sl_buff[2] != '*' || sl_buff[3] != '/')
-            {
-                sl_buff[0] = sl_buff[1];
-                sl_buff[1] = sl_buff[2];
-                sl_buff[2] = sl_buff[3];
-                sl_buff[3] = c;
-                if (i == SKELETON_LEN - 1 || c == '\n')
-                {
-                    fail_error("Line %i, col %i : Syntax error in the skelton file, replace pattern never closed", line, column);
-                    fail_error("Please report the issue to https://github.com/bourquenoud/ass");
-                    abort();
-                }
-                c = SKELETON[++i];
-            }
-
-            // Execute the function
-            callable_t function = hash_get(function_table, name_buff);
-            if (function == NULL)
-            {
-                fail_error("Line %i, col %i : Syntax error in the skelton file, '%s' not registered", line, column, name_buff);
-                fail_error("Please report the issue to https://github.com/bourquenoud/ass");
-                abort();
-            }
-            function(column / 4 - 1);
-
-            // Wait for the buffer to refill before printing again
-            wait_index = i + 4;
-        }
-        else if (i >= wait_index)
-        {
-            putc(sl_buff[0], fd);
-        }
+        generator_emit(text + segment->offset, segment->length);
+        callbacks[segment->marker](segment->indent);
     }
 
-    // Flush the buffer
-    putc(sl_buff[1], fd);
-    putc(sl_buff[2], fd);
-    putc(sl_buff[3], fd);
-}
\ No newline at end of file
+    // The last segment runs to the end of the skeleton
+    if (segment->offset < skeleton_len)
+        generator_emit(text + segment->offset, skeleton_len - segment->offset);
+}
@@ -2,6 +2,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <regex.h>
 #include <string.h>
 #include <ctype.h>
@@ -9,9 +10,45 @@
 #include "hash_array.h"
 #include "generator.h"
 
+// Part of a skeleton: a literal segment, then the replace pattern following it
+typedef struct
+{
+    unsigned int offset; // Start of the literal segment in the skeleton
+    unsigned int length; // Length of the literal segment
+    int marker;          // Replace pattern following the segment, -1 for the last segment which ends with the skeleton
+    int indent;          // Indentation level of the pattern
+} skeleton_segment_t;
+
 /**
  * @brief Generate the file
  * 
  * @param fd The file descriptor to write to
  */
-void generate(FILE* fd);
\ No newline at end of file
+void generate(FILE* fd);
+
+/**
+ * @brief Generate the header of the library
+ *
+ * @param fd The file descriptor to write to
+ */
+void generate_header(FILE* fd);
+
+/**
+ * @brief Generate the assembler as a directory of translation units sharing a header, with a Makefile
+ *
+ * @details The runtime core, the lexer and the parser each get their own file, the actions
+ *          are dealt to several files so "make -j" can compile them in parallel
+ *
+ * @param dir The existing directory to write to
+ * @param shards Number of files the actions are dealt to
+ * @return true on success, false if a file could not be opened
+ */
+bool generate_directory(char const *dir, int shards);
+
+/**
+ * @brief Add the embedded skeletons to a hash, so a cached output is not reused by another build of ass
+ *
+ * @param hash The hash so far
+ * @return uint64_t The new hash
+ */
+uint64_t generate_skeleton_hash(uint64_t hash);
@@ -0,0 +1,178 @@
+#include "profile.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "hash_array.h"
+#include "dynamic_array.h"
+#include "cache.h"
+#include "failure.h"
+
+#define PROFILE_TABLE_SIZE 1024
+#define PROFILE_LINE_SIZE 256
+
+static hash_t *sites = NULL;       // Index in counts of each site, keyed by "machine fingerprint state target"
+static darray_t *counts = NULL;    // uint64_t count of each site
+static hash_t *recorded = NULL;    // Keyed by "machine" and "machine fingerprint" for each machine of the profiles
+static hash_t *selected = NULL;    // Index in fingerprints of the state machine being generated, keyed by "machine"
+static darray_t *fingerprints = NULL; // uint64_t fingerprint of each selected state machine
+static uint64_t digest = CACHE_HASH_INIT;
+
+// Key of a site in the table
+static void site_key(char *key, size_t size, char const *machine, uint64_t fingerprint, int state, int target);
+// Key of a state machine recorded by the profiles
+static void machine_key(char *key, size_t size, char const *machine, uint64_t fingerprint);
+// Check a key of a table whose values can be NULL or 0
+static bool has_key(hash_t *table, char *key);
+
+/*********************************************************************/
+
+bool profile_load(char const *path)
+{
+    FILE *fd = fopen(path, "r");
+    if (fd == NULL)
+    {
+        fail_error("%s (%s)", strerror(errno), path);
+        return false;
+    }
+
+    if (sites == NULL)
+    {
+        sites = hash_init(PROFILE_TABLE_SIZE);
+        counts = darray_init(sizeof(uint64_t));
+        recorded = hash_init(PROFILE_TABLE_SIZE);
+        selected = hash_init(PROFILE_TABLE_SIZE);
+        fingerprints = darray_init(sizeof(uint64_t));
+    }
+
+    char line[PROFILE_LINE_SIZE];
+    int line_number = 0;
+    // The fingerprint line of a state machine comes before its sites, a site without one is never used
+    char fingerprint_machine[16] = "";
+    uint64_t fingerprint = 0;
+    while (fgets(line, sizeof(line), fd) != NULL)
+    {
+        line_number++;
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+
+        char machine[16];
+        int state, target;
+        unsigned long long count;
+        if (sscanf(line, "fingerprint %15s %llx", machine, &count) == 2)
+        {
+            digest = cache_hash_string(digest, line);
+            strcpy(fingerprint_machine, machine);
+            fingerprint = count;
+            continue;
+        }
+        if (sscanf(line, "%15s %i %i %llu", machine, &state, &target, &count) != 4)
+        {
+            fail_warning("Ignoring the malformed line %i of the profile %s", line_number, path);
+            continue;
+        }
+        digest = cache_hash_string(digest, line);
+
+        uint64_t site_fingerprint = strcmp(machine, fingerprint_machine) == 0 ? fingerprint : 0;
+        char key[PROFILE_LINE_SIZE];
+        hash_add(recorded, machine, NULL);
+        machine_key(key, sizeof(key), machine, site_fingerprint);
+        hash_add(recorded, key, NULL);
+
+        // The counters of the same site in several profiles add up
+        site_key(key, sizeof(key), machine, site_fingerprint, state, target);
+        void *index;
+        if (hash_try_get(sites, key, &index))
+        {
+            darray_at(&counts, uint64_t, (intptr_t)index) += count;
+        }
+        else
+        {
+            uint64_t value = count;
+            hash_add(sites, key, (void *)(intptr_t)counts->count);
+            darray_add(&counts, value);
+        }
+    }
+
+    fclose(fd);
+    fail_debug("Loaded the profile %s", path);
+    return true;
+}
+
+bool profile_select(char const *machine, uint64_t fingerprint)
+{
+    if (sites == NULL)
+        return false;
+
+    char key[PROFILE_LINE_SIZE];
+    machine_key(key, sizeof(key), machine, fingerprint);
+    bool matches = has_key(recorded, key);
+
+    // Only the first call warns, the same state machine can be generated in several places
+    strcpy(key, machine);
+    if (!has_key(selected, key))
+    {
+        if (!matches && has_key(recorded, key))
+            fail_warning("The profiles of the %s were recorded on another state machine, they are ignored", machine);
+        hash_add(selected, key, (void *)(intptr_t)fingerprints->count);
+        darray_add(&fingerprints, fingerprint);
+    }
+    return matches;
+}
+
+uint64_t profile_count(char const *machine, int state, int target)
+{
+    if (sites == NULL)
+        return 0;
+
+    char key[PROFILE_LINE_SIZE];
+    strcpy(key, machine);
+    void *index;
+    if (!hash_try_get(selected, key, &index))
+        return 0;
+
+    site_key(key, sizeof(key), machine, darray_at(&fingerprints, uint64_t, (intptr_t)index), state, target);
+    if (!hash_try_get(sites, key, &index))
+        return 0;
+    return darray_at(&counts, uint64_t, (intptr_t)index);
+}
+
+uint64_t profile_hash(uint64_t hash)
+{
+    if (sites == NULL)
+        return hash;
+    return cache_hash(hash, &digest, sizeof(digest));
+}
+
+void profile_free(void)
+{
+    if (sites == NULL)
+        return;
+
+    hash_free(sites);
+    darray_destroy(&counts);
+    hash_free(recorded);
+    hash_free(selected);
+    darray_destroy(&fingerprints);
+    sites = NULL;
+    digest = CACHE_HASH_INIT;
+}
+
+/*********************************************************************/
+
+static void site_key(char *key, size_t size, char const *machine, uint64_t fingerprint, int state, int target)
+{
+    snprintf(key, size, "%s %016llx %i %i", machine, (unsigned long long)fingerprint, state, target);
+}
+
+static void machine_key(char *key, size_t size, char const *machine, uint64_t fingerprint)
+{
+    snprintf(key, size, "%s %016llx", machine, (unsigned long long)fingerprint);
+}
+
+static bool has_key(hash_t *table, char *key)
+{
+    void *value;
+    return hash_try_get(table, key, &value);
+}
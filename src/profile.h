@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Targets of the profile sites that are not transitions, shared with the generated assemblers
+#define PROFILE_EXIT -1
+#define PROFILE_INVALID -2
+
+/**
+ * @brief Load the counters written by a generated assembler with "--profile-out"
+ *
+ * @details Can be called for several profiles, the counters of a same site of a same state machine add up
+ *
+ * @param path Path of the profile
+ * @return true if the profile has been read
+ */
+bool profile_load(char const *path);
+
+/**
+ * @brief Select the counters recorded on a state machine, before profile_count
+ *
+ * @details The profiles only apply to the state machine they were recorded on. Warn once when the profiles have
+ * counters for the machine but from another state machine, for example after a change of the specification
+ *
+ * @param machine Name of the state machine, "lexer" or "parser"
+ * @param fingerprint Fingerprint of the state machine being generated, written in the profiles by the assembler
+ * @return true if the profiles have counters for this state machine
+ */
+bool profile_select(char const *machine, uint64_t fingerprint);
+
+/**
+ * @brief Get the number of times a site of the selected state machine has been reached
+ *
+ * @param machine Name of the state machine, "lexer" or "parser"
+ * @param state Id of the state
+ * @param target Id of the next state, PROFILE_EXIT or PROFILE_INVALID for the default case of the state
+ * @return uint64_t The count, 0 for a site missing from the profiles or a machine that does not match them
+ */
+uint64_t profile_count(char const *machine, int state, int target);
+
+/**
+ * @brief Add the loaded profiles to a hash, they change the generated code
+ *
+ * @param hash The hash so far
+ * @return uint64_t The new hash
+ */
+uint64_t profile_hash(uint64_t hash);
+
+/**
+ * @brief Free the loaded profiles
+ */
+void profile_free(void);
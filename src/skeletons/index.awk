@@ -0,0 +1,67 @@
+# Index the replace patterns of a skeleton, so the populator can emit it without scanning it
+#
+# Usage: awk -v name=ARRAY_NAME -f index.awk markers.def SKELETON_FILE
+#
+# Prints a table of skeleton_segment_t: each entry is a literal segment of the skeleton followed
+# by the pattern replacing it, the last entry has no pattern and ends with the skeleton.
+# Patterns not listed in markers.def are rejected. Offsets are in bytes, run it with LC_ALL=C.
+
+function fail(message)
+{
+    printf("%s:%d: %s\n", FILENAME, FNR, message) > "/dev/stderr"
+    failed = 1
+    exit 1
+}
+
+# Known patterns
+FNR == NR {
+    if (match($0, /^MARKER\([A-Za-z0-9_]+\)/))
+        known[substr($0, 8, RLENGTH - 8)] = 1
+    next
+}
+
+FNR == 1 {
+    printf("// Literal segments and replace patterns of %s, generated by index.awk\n", FILENAME)
+    printf("static const skeleton_segment_t %s_SEGMENTS[] = {\n", name)
+    offset = 0 # Offset of the current line
+    start = 0  # Start of the literal segment not indexed yet
+}
+
+{
+    line = $0
+    pos = 1
+    while ((found = index(substr(line, pos), "/*!!")) > 0)
+    {
+        column = pos + found - 1
+        rest = substr(line, column + 4)
+        close_at = index(rest, "!!*/")
+        if (close_at == 0)
+            fail("replace pattern never closed")
+
+        pattern = substr(rest, 1, close_at - 1)
+        sub(/^[ \t]+/, "", pattern)
+        if (!match(pattern, /^[A-Za-z0-9_]+/))
+            fail("no name in replace pattern")
+        marker = substr(pattern, 1, RLENGTH)
+        if (!(marker in known))
+            fail("'" marker "' is not a pattern of markers.def")
+
+        # Same indentation level as the pattern
+        printf("    {%d, %d, MARKER_%s, %d},\n", start, offset + column - 1 - start, marker, int((column + 4) / 4) - 1)
+
+        # The character following the pattern is dropped, the generators end with their own new line
+        end = column + 4 + close_at - 1 + 4
+        start = offset + end
+        pos = end + 1
+        if (pos > length(line))
+            break
+    }
+    offset += length(line) + 1
+}
+
+END {
+    if (failed)
+        exit 1
+    printf("    {%d, 0, -1, 0},\n", start)
+    printf("};\n")
+}
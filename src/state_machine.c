@@ -17,13 +17,78 @@ state_machine_t state_machine_init()
     new_state.end_state = 0;
     new_state.output = -1;
     new_state_machine.states_tstate = darray_init(sizeof(state_t));
+    new_state_machine.arena = NULL;
     darray_add(&(new_state_machine.states_tstate), new_state);
 
     return new_state_machine;
 }
 
+void state_machine_destroy(state_machine_t *state_machine)
+{
+    if (state_machine->states_tstate == NULL)
+        return;
+
+    // Everything is freed at once with the arena
+    if (state_machine->arena != NULL)
+    {
+        arena_destroy(state_machine->arena);
+        state_machine->arena = NULL;
+        state_machine->states_tstate = NULL;
+        return;
+    }
+
+    for (size_t i = 0; i < state_machine->states_tstate->count; i++)
+        darray_destroy(&(darray_at(&(state_machine->states_tstate), state_t, i).transitions_ttrans));
+    darray_destroy(&(state_machine->states_tstate));
+}
+
+arena_t *state_machine_arena_begin(void)
+{
+    arena_t *arena = arena_init(ARENA_DEFAULT_CHUNK);
+    arena_enter(arena);
+    return arena;
+}
+
+void state_machine_arena_end(state_machine_t *state_machine, arena_t *arena)
+{
+    arena_leave();
+    state_machine->arena = arena;
+}
+
+void state_machine_compact(state_machine_t *state_machine)
+{
+    int count = state_machine->states_tstate->count;
+    state_t *states = darray_get_ptr(&(state_machine->states_tstate), 0);
+
+    // Exact size of the block, the arrays hold at least one element
+    size_t size = arena_round(sizeof(darray_t) + sizeof(state_t) * (count > 0 ? count : 1));
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t transitions = states[i].transitions_ttrans->count;
+        size += arena_round(sizeof(darray_t) + sizeof(transistion_t) * (transitions > 0 ? transitions : 1));
+    }
+
+    arena_t *arena = arena_init(size);
+    arena_enter(arena);
+    state_machine_t compact = {.states_tstate = darray_init_size(sizeof(state_t), count), .arena = NULL};
+    for (size_t i = 0; i < count; i++)
+    {
+        state_t state = states[i];
+        darray_t *transitions = states[i].transitions_ttrans;
+        state.transitions_ttrans = darray_init_size(sizeof(transistion_t), transitions->count);
+        darray_append_n(&(state.transitions_ttrans), transitions->element_list, transitions->count);
+        darray_add(&(compact.states_tstate), state);
+    }
+    state_machine_arena_end(&compact, arena);
+
+    state_machine_destroy(state_machine);
+    *state_machine = compact;
+}
+
 void state_machine_remove_state(state_machine_t *state_machine)
 {
+    state_t *last = darray_get_ptr(&(state_machine->states_tstate), state_machine->states_tstate->count - 1);
+    darray_destroy(&(last->transitions_ttrans));
     darray_remove(&(state_machine->states_tstate), 1);
 }
 
@@ -149,10 +214,20 @@ state_machine_t state_machine_merge(state_machine_t *state_machine_a, state_mach
 {
     int corresp_table[state_machine_b->states_tstate->count][2];
 
+    arena_t *arena = state_machine_arena_begin();
     state_machine_t new_state_machine = state_machine_init();
+    darray_destroy(&(darray_at(&(new_state_machine.states_tstate), state_t, 0).transitions_ttrans));
 
-    // Copy the state machine A in one go
+    // Copy the state machine A in one go, then clone its transitions so A can be destroyed
     darray_copy(&(new_state_machine.states_tstate), &(state_machine_a->states_tstate));
+    darray_reserve(&(new_state_machine.states_tstate), state_machine_a->states_tstate->count + state_machine_b->states_tstate->count);
+    for (size_t i = 0; i < new_state_machine.states_tstate->count; i++)
+    {
+        state_t *state = darray_get_ptr(&(new_state_machine.states_tstate), i);
+        darray_t *transitions = state->transitions_ttrans;
+        state->transitions_ttrans = darray_init(sizeof(transistion_t));
+        darray_append_n(&(state->transitions_ttrans), transitions->element_list, transitions->count);
+    }
 
     // Add each state of the state machine B, skipping the starting state
     for (size_t i = 1; i < state_machine_b->states_tstate->count; i++)
@@ -241,34 +316,99 @@ state_machine_t state_machine_merge(state_machine_t *state_machine_a, state_mach
         exit(EXIT_FAILURE);
     }
 
+    state_machine_arena_end(&new_state_machine, arena);
     return new_state_machine;
 }
 
+// Hash of a state, independent of the order of its transitions
+static uint64_t state_hash(state_t *state)
+{
+    uint64_t hash = (uint64_t)state->end_state * 0x9E3779B97F4A7C15LLU ^ (uint64_t)(int64_t)state->output;
+    transistion_t *transitions = darray_get_ptr(&(state->transitions_ttrans), 0);
+    for (size_t i = 0; i < state->transitions_ttrans->count; i++)
+    {
+        uint64_t mixed = ((uint64_t)(uint32_t)transitions[i].condition << 32 | (uint32_t)transitions[i].next_state_id) * 0xFF51AFD7ED558CCDLLU;
+        hash += mixed ^ (mixed >> 29);
+    }
+    return hash + state->transitions_ttrans->count;
+}
+
 void state_machine_reduce(state_machine_t *state_machine)
 {
     // Two state can be merged if they have the same end_state, the same output and the same transitions
     bool has_merged = true;
 
-    // Stop when we can not merge more states
+    // Stop when we can not merge more states. Each pass merges every state with the first identical one,
+    //  found through a hash table, then redirects the transitions
     while (has_merged)
     {
         int count = state_machine->states_tstate->count;
         state_t *state_array = (state_t *)darray_get_ptr(&(state_machine->states_tstate), 0);
         has_merged = false;
-        // We check each state against all other states
-        for (size_t i = 0; i < count && !has_merged; i++)
+
+        int capacity = 16;
+        while (capacity < 2 * count)
+            capacity *= 2;
+        int *table = xmalloc(sizeof(int) * capacity); // Index of the first state of each hash, -1 if empty
+        memset(table, -1, sizeof(int) * capacity);
+
+        int max_id = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            max_id = state_array[i].id > max_id ? state_array[i].id : max_id;
+            transistion_t *transitions = darray_get_ptr(&(state_array[i].transitions_ttrans), 0);
+            for (size_t j = 0; j < state_array[i].transitions_ttrans->count; j++)
+                max_id = transitions[j].next_state_id > max_id ? transitions[j].next_state_id : max_id;
+        }
+
+        int *new_ids = xmalloc(sizeof(int) * (max_id + 1)); // Id replacing each id
+        for (int i = 0; i <= max_id; i++)
+            new_ids[i] = i;
+        bool *merged = xmalloc(sizeof(bool) * count);
+
+        for (size_t i = 0; i < count; i++)
         {
-            for (size_t j = i + 1; j < count && !has_merged; j++)
+            merged[i] = false;
+
+            uint64_t slot = state_hash(state_array + i) & (capacity - 1);
+            while (table[slot] >= 0 && !state_compare_states(state_array + table[slot], state_array + i))
+                slot = (slot + 1) & (capacity - 1);
+
+            if (table[slot] < 0)
             {
-                if (state_compare_states(state_array + i, state_array + j))
-                {
-                    // We can merge the two states
-                    state_machine_replace_id(state_machine, state_array[i].id, state_array[j].id);
-                    darray_remove_at(&(state_machine->states_tstate), 1, j);
-                    has_merged = true;
-                }
+                table[slot] = i;
+            }
+            else
+            {
+                new_ids[state_array[i].id] = state_array[table[slot]].id;
+                merged[i] = true;
+                has_merged = true;
+            }
+        }
+
+        // Redirect the transitions and drop the merged states, keeping the order of the others
+        int kept = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (merged[i])
+            {
+                darray_destroy(&(state_array[i].transitions_ttrans));
+                continue;
             }
+
+            transistion_t *transitions = darray_get_ptr(&(state_array[i].transitions_ttrans), 0);
+            for (size_t j = 0; j < state_array[i].transitions_ttrans->count; j++)
+            {
+                if (transitions[j].next_state_id >= 0)
+                    transitions[j].next_state_id = new_ids[transitions[j].next_state_id];
+            }
+            state_array[kept++] = state_array[i];
         }
+        state_machine->states_tstate->count = kept;
+
+        free(table);
+        free(new_ids);
+        free(merged);
     }
 }
 
@@ -314,6 +454,9 @@ state_machine_t state_machine_make_deterministic(state_machine_t *nfa)
     // Contains the generated state combination
     bitarray_t new_state_combination;
 
+    // The DFA and the work arrays of the construction are freed together
+    arena_t *arena = state_machine_arena_begin();
+
     // Store all generated state in the form of a bit array
     darray_t *generated_state_table = darray_init(sizeof(bitarray_t));
 
@@ -355,8 +498,8 @@ state_machine_t state_machine_make_deterministic(state_machine_t *nfa)
         }
 
         // Empty the current states array
-        darray_empty(&current_states);
-        darray_empty(&current_transitions);
+        darray_clear(&current_states);
+        darray_clear(&current_transitions);
 
         // Add all the state we are currently using
         for (size_t j = 0; j < MAX_STATE / sizeof(uint32_t); j++)
@@ -519,12 +662,135 @@ state_machine_t state_machine_make_deterministic(state_machine_t *nfa)
         }
     }    
 
+    darray_destroy(&generated_state_table);
+    darray_destroy(&current_states); // Copies of the states of the NFA, their transitions are not owned
+    darray_destroy(&current_transitions);
+    darray_destroy(&conflict_output_table);
+    darray_destroy(&end_state_ids);
+    state_machine_arena_end(&dfa, arena);
+
     // Reduction pass
     state_machine_reduce(&dfa);
 
     return dfa;
 }
 
+// Index of each state id, -1 for the ids not used
+static int *state_machine_index_table(state_machine_t *state_machine)
+{
+    int count = state_machine->states_tstate->count;
+    state_t *state_array = darray_get_ptr(&(state_machine->states_tstate), 0);
+
+    int max_id = 0;
+    for (size_t i = 0; i < count; i++)
+        max_id = state_array[i].id > max_id ? state_array[i].id : max_id;
+
+    int *indexes = xmalloc(sizeof(int) * (max_id + 1));
+    memset(indexes, -1, sizeof(int) * (max_id + 1));
+    for (size_t i = 0; i < count; i++)
+        indexes[state_array[i].id] = i;
+    return indexes;
+}
+
+// Index of the state reached from a state of a dfa, -1 if there is no transition
+static int state_machine_next_index(state_t *state, int *indexes, int condition)
+{
+    if (state == NULL)
+        return -1;
+
+    transistion_t *transitions = darray_get_ptr(&(state->transitions_ttrans), 0);
+    for (size_t i = 0; i < state->transitions_ttrans->count; i++)
+    {
+        if (transitions[i].condition == condition)
+            return indexes[transitions[i].next_state_id];
+    }
+    return -1;
+}
+
+state_machine_t state_machine_product(state_machine_t *dfa_a, state_machine_t *dfa_b)
+{
+    state_t *states_a = darray_get_ptr(&(dfa_a->states_tstate), 0);
+    state_t *states_b = darray_get_ptr(&(dfa_b->states_tstate), 0);
+    int *indexes_a = state_machine_index_table(dfa_a);
+    int *indexes_b = state_machine_index_table(dfa_b);
+
+    // Pairs of indexes of the states of A and B, -1 when one of the machines has no more transitions.
+    //  The id of a new state is the index of its pair
+    arena_t *arena = state_machine_arena_begin();
+    darray_t *pairs = darray_init(sizeof(int[2]));
+    hash_t *pair_ids = hash_init(dfa_a->states_tstate->count + dfa_b->states_tstate->count);
+    char key[24];
+
+    state_machine_t product = state_machine_init();
+    darray_add(&pairs, ((int[2]){indexes_a[0], indexes_b[0]}));
+    hash_add(pair_ids, "0:0", (void *)(intptr_t)1); // Ids are stored plus one, NULL is not found
+
+    for (size_t i = 0; i < pairs->count; i++)
+    {
+        int pair[2];
+        darray_get(&pairs, pair, i);
+        state_t *state_a = pair[0] < 0 ? NULL : states_a + pair[0];
+        state_t *state_b = pair[1] < 0 ? NULL : states_b + pair[1];
+
+        if (i != 0)
+        {
+            state_t new_state = state_init_state(i);
+            darray_add(&(product.states_tstate), new_state);
+        }
+        state_t *state = darray_get_ptr(&(product.states_tstate), i);
+
+        // End state if any of the machines accept, priority is given to the lowest output
+        int output_a = state_a != NULL && state_a->end_state ? state_a->output : -1;
+        int output_b = state_b != NULL && state_b->end_state ? state_b->output : -1;
+        state->end_state = (state_a != NULL && state_a->end_state) || (state_b != NULL && state_b->end_state);
+        state->output = output_a == -1 || (output_b != -1 && output_b < output_a) ? output_b : output_a;
+
+        // The conditions of A first, then the ones only B has
+        for (int side = 0; side < 2; side++)
+        {
+            state_t *source = side == 0 ? state_a : state_b;
+            if (source == NULL)
+                continue;
+
+            for (size_t j = 0; j < source->transitions_ttrans->count; j++)
+            {
+                int condition = ((transistion_t *)darray_get_ptr(&(source->transitions_ttrans), j))->condition;
+                if (side == 1 && state_machine_next_index(state_a, indexes_a, condition) >= 0)
+                    continue;
+
+                int next[2] = {state_machine_next_index(state_a, indexes_a, condition),
+                               state_machine_next_index(state_b, indexes_b, condition)};
+                snprintf(key, sizeof(key), "%i:%i", next[0], next[1]);
+
+                void *found;
+                int next_id;
+                if (hash_try_get(pair_ids, key, &found))
+                {
+                    next_id = (intptr_t)found - 1;
+                }
+                else
+                {
+                    next_id = pairs->count;
+                    darray_add(&pairs, next);
+                    hash_add(pair_ids, key, (void *)(intptr_t)(next_id + 1));
+                }
+
+                // The array may have been moved by the previous additions
+                state = darray_get_ptr(&(product.states_tstate), i);
+                state_add_transition(state, next_id, condition);
+            }
+        }
+    }
+
+    hash_free(pair_ids);
+    darray_destroy(&pairs);
+    state_machine_arena_end(&product, arena);
+    free(indexes_a);
+    free(indexes_b);
+
+    return product;
+}
+
 // return true if identique, false otherwise
 bool state_compare_states(state_t *s1, state_t *s2)
 {
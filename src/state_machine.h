@@ -9,6 +9,7 @@
 #include "xmalloc.h"
 #include "dynamic_array.h"
 #include "hash_array.h"
+#include "arena.h"
 
 typedef struct state_s state_t;
 
@@ -29,6 +30,7 @@ struct state_s
 typedef struct
 {
     darray_t *states_tstate;
+    arena_t *arena; // Arena holding the states and their transitions, NULL when they are on the heap
 } state_machine_t;
 
 /**
@@ -56,12 +58,42 @@ state_t *state_machine_add_state(state_machine_t *state_machine, int end_state);
  */
 state_machine_t state_machine_init();
 
+/**
+ * @brief Free the states of a state machine and their transitions
+ *
+ * @param state_machine The state machine, left without states
+ */
+void state_machine_destroy(state_machine_t *state_machine);
+
+/**
+ * @brief Start building a state machine in a new arena, on the calling thread
+ * @details Every dynamic array initialised until state_machine_arena_end comes from it
+ *
+ * @return arena_t* The arena
+ */
+arena_t *state_machine_arena_begin(void);
+
+/**
+ * @brief Stop building a state machine in an arena, the state machine frees it when destroyed
+ *
+ * @param state_machine The state machine built since state_machine_arena_begin
+ * @param arena The arena returned by state_machine_arena_begin
+ */
+void state_machine_arena_end(state_machine_t *state_machine, arena_t *arena);
+
+/**
+ * @brief Copy a state machine to a single block, sized to its states and transitions, and destroy the original
+ *
+ * @param state_machine The state machine, replaced by its copy
+ */
+void state_machine_compact(state_machine_t *state_machine);
+
 /**
  * @brief Merge two state machines
  * 
  * @param state_machine_a The first state machine
  * @param state_machine_b The second state machine
- * @return state_machine_t The merged state machine
+ * @return state_machine_t The merged state machine, it shares no memory with the two others
  */
 state_machine_t state_machine_merge(state_machine_t *state_machine_a, state_machine_t *state_machine_b);
 
@@ -132,7 +164,19 @@ transistion_t *state_machine_get_transitions(state_machine_t *state_machine, int
 state_machine_t state_machine_make_deterministic(state_machine_t *nfa);
 
 /**
- * @brief Remove a state from the state machine
+ * @brief Build the deterministic state machine running two deterministic state machines side by side
+ *
+ * @details A state of the product is a pair of states of the machines. It is an end state if any of
+ *          them is, and priority is given to the lowest output like in the subset construction.
+ *
+ * @param dfa_a The first deterministic state machine
+ * @param dfa_b The second deterministic state machine
+ * @return state_machine_t The product, its state ids are their indexes
+ */
+state_machine_t state_machine_product(state_machine_t *dfa_a, state_machine_t *dfa_b);
+
+/**
+ * @brief Remove the last state of the state machine, and free its transitions
  * 
  * @param state_machine The state machine
  */
@@ -0,0 +1,186 @@
+#include "stats.h"
+
+#include <time.h>
+#include <sys/resource.h>
+#include <pthread.h>
+
+#include "dynamic_array.h"
+#include "failure.h"
+
+#define MAX_PHASE_DEPTH 16
+
+typedef struct
+{
+    char const *name;
+    int depth;
+    int parent;  // Index of the enclosing phase of the same thread, -1 for a top-level phase
+    double time; // Start time until the phase ends, then its duration
+    long peak_rss;
+} phase_t;
+
+typedef struct
+{
+    char const *name;
+    int states;
+    int transitions;
+} machine_snapshot_t;
+
+static bool enabled = false;
+static bool as_json = false;
+static darray_t *phases = NULL;
+static darray_t *machines = NULL;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER; // The phases of the tasks run on several threads
+static _Thread_local int open_phases[MAX_PHASE_DEPTH];
+static _Thread_local int open_count = 0;
+static long output_size = -1;
+
+// Wall time in seconds from a monotonic clock
+static double now(void);
+// Peak resident set size of the process in KiB
+static long peak_rss(void);
+// Print a phase then the phases it encloses, so the phases of different threads are not interleaved
+static void print_phase(FILE *fd, phase_t const *phase_list, size_t count, size_t index);
+
+/*********************************************************************/
+
+void stats_enable(bool json)
+{
+    enabled = true;
+    as_json = json;
+    if (phases == NULL)
+    {
+        phases = darray_init(sizeof(phase_t));
+        machines = darray_init(sizeof(machine_snapshot_t));
+    }
+}
+
+bool stats_enabled(void)
+{
+    return enabled;
+}
+
+void stats_begin(char const *name)
+{
+    if (!enabled)
+        return;
+
+    if (open_count >= MAX_PHASE_DEPTH)
+    {
+        fail_error("Statistics phases nested too deeply");
+        return;
+    }
+
+    phase_t phase = {.name = name, .depth = open_count, .parent = open_count ? open_phases[open_count - 1] : -1, .time = now(), .peak_rss = 0};
+    pthread_mutex_lock(&lock);
+    open_phases[open_count++] = phases->count;
+    darray_add(&phases, phase);
+    pthread_mutex_unlock(&lock);
+}
+
+void stats_end(void)
+{
+    if (!enabled || open_count == 0)
+        return;
+
+    double end = now();
+    long rss = peak_rss();
+    pthread_mutex_lock(&lock);
+    phase_t *phase = darray_get_ptr(&phases, open_phases[--open_count]);
+    phase->time = end - phase->time;
+    phase->peak_rss = rss;
+    pthread_mutex_unlock(&lock);
+}
+
+void stats_machine(char const *name, state_machine_t *state_machine)
+{
+    if (!enabled)
+        return;
+
+    machine_snapshot_t snapshot = {.name = name, .states = state_machine->states_tstate->count, .transitions = 0};
+    state_t *states = darray_get_ptr(&state_machine->states_tstate, 0);
+    for (size_t i = 0; i < state_machine->states_tstate->count; i++)
+        snapshot.transitions += states[i].transitions_ttrans->count;
+
+    pthread_mutex_lock(&lock);
+    darray_add(&machines, snapshot);
+    pthread_mutex_unlock(&lock);
+}
+
+void stats_output_size(long size)
+{
+    output_size = size;
+}
+
+void stats_print(FILE *fd)
+{
+    if (!enabled)
+        return;
+
+    phase_t *phase_list = darray_get_ptr(&phases, 0);
+    machine_snapshot_t *machine_list = darray_get_ptr(&machines, 0);
+
+    if (as_json)
+    {
+        fprintf(fd, "{\"phases\": [");
+        for (size_t i = 0; i < phases->count; i++)
+            fprintf(fd, "%s{\"name\": \"%s\", \"depth\": %i, \"parent\": %i, \"time\": %f, \"peak_rss_kib\": %li}",
+                    i ? ", " : "", phase_list[i].name, phase_list[i].depth, phase_list[i].parent, phase_list[i].time,
+                    phase_list[i].peak_rss);
+        fprintf(fd, "], \"machines\": [");
+        for (size_t i = 0; i < machines->count; i++)
+            fprintf(fd, "%s{\"name\": \"%s\", \"states\": %i, \"transitions\": %i}",
+                    i ? ", " : "", machine_list[i].name, machine_list[i].states, machine_list[i].transitions);
+        fprintf(fd, "], \"output_size\": %li}\n", output_size);
+        return;
+    }
+
+    fprintf(fd, "%-44s %12s %16s\n", "Phase", "Time (ms)", "Peak RSS (KiB)");
+    for (size_t i = 0; i < phases->count; i++)
+    {
+        if (phase_list[i].parent < 0)
+            print_phase(fd, phase_list, phases->count, i);
+    }
+
+    fprintf(fd, "\n%-44s %12s %16s\n", "State machine", "States", "Transitions");
+    for (size_t i = 0; i < machines->count; i++)
+        fprintf(fd, "%-44s %12i %16i\n", machine_list[i].name, machine_list[i].states, machine_list[i].transitions);
+
+    if (output_size >= 0)
+        fprintf(fd, "\nOutput size: %li bytes\n", output_size);
+}
+
+/*********************************************************************/
+
+static void print_phase(FILE *fd, phase_t const *phase_list, size_t count, size_t index)
+{
+    phase_t const *phase = &phase_list[index];
+    fprintf(fd, "%*s%-*s %12.3f %16li\n", 2 * phase->depth, "", 44 - 2 * phase->depth, phase->name, phase->time * 1000,
+            phase->peak_rss);
+
+    // A phase starts after its parent
+    for (size_t i = index + 1; i < count; i++)
+    {
+        if (phase_list[i].parent == (int)index)
+            print_phase(fd, phase_list, count, i);
+    }
+}
+
+static double now(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+static long peak_rss(void)
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // Bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+}
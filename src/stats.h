@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "state_machine.h"
+
+/**
+ * @brief Enable the collection of the statistics
+ *
+ * @param json Print the report as JSON instead of text
+ */
+void stats_enable(bool json);
+
+/**
+ * @brief Check if the statistics are collected
+ *
+ * @return true if stats_enable has been called
+ */
+bool stats_enabled(void);
+
+/**
+ * @brief Start timing a phase. Phases can be nested
+ *
+ * @param name Name of the phase, must outlive the report
+ */
+void stats_begin(char const *name);
+
+/**
+ * @brief Stop timing the last started phase, and record its wall time and the peak RSS
+ */
+void stats_end(void);
+
+/**
+ * @brief Record the number of states and transitions of a state machine
+ *
+ * @param name Name of the snapshot, must outlive the report
+ * @param state_machine The state machine to count
+ */
+void stats_machine(char const *name, state_machine_t *state_machine);
+
+/**
+ * @brief Record the size of the emitted file, or of all the files of an output directory
+ *
+ * @param size Size in bytes, negative if unknown
+ */
+void stats_output_size(long size);
+
+/**
+ * @brief Print the collected statistics
+ *
+ * @param fd The file descriptor to write to
+ */
+void stats_print(FILE *fd);
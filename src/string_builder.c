@@ -0,0 +1,113 @@
+#include "string_builder.h"
+
+#include "macro.h"
+
+#define DEFAULT_SBUILDER_CAPACITY 256
+
+string_builder_t *sbuilder_init(void)
+{
+    string_builder_t *builder = malloc(sizeof(string_builder_t));
+    char *data = malloc(DEFAULT_SBUILDER_CAPACITY);
+    if (builder == NULL || data == NULL)
+    {
+        fputs(STR(__FILE__) ":" STR(__LINE__) "  Cannot allocate a string builder\n", stderr);
+        abort();
+    }
+
+    data[0] = '\0';
+    *builder = (string_builder_t){.data = data, .length = 0, .capacity = DEFAULT_SBUILDER_CAPACITY};
+    return builder;
+}
+
+void sbuilder_reserve(string_builder_t *builder, size_t size)
+{
+    size_t needed = builder->length + size + 1;
+    if (needed <= builder->capacity)
+        return;
+
+    // Double the capacity so appending is amortised constant time
+    size_t capacity = builder->capacity;
+    while (capacity < needed)
+        capacity *= 2;
+
+    builder->data = realloc(builder->data, capacity);
+    if (builder->data == NULL)
+    {
+        fputs(STR(__FILE__) ":" STR(__LINE__) "  Cannot grow a string builder\n", stderr);
+        abort();
+    }
+    builder->capacity = capacity;
+}
+
+void sbuilder_append(string_builder_t *builder, char const *data, size_t length)
+{
+    sbuilder_reserve(builder, length);
+    memcpy(builder->data + builder->length, data, length);
+    builder->length += length;
+    builder->data[builder->length] = '\0';
+}
+
+void sbuilder_puts(string_builder_t *builder, char const *str)
+{
+    sbuilder_append(builder, str, strlen(str));
+}
+
+void sbuilder_repeat(string_builder_t *builder, char c, size_t count)
+{
+    sbuilder_reserve(builder, count);
+    memset(builder->data + builder->length, c, count);
+    builder->length += count;
+    builder->data[builder->length] = '\0';
+}
+
+void sbuilder_printf(string_builder_t *builder, char const *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    sbuilder_vprintf(builder, format, args);
+    va_end(args);
+}
+
+void sbuilder_vprintf(string_builder_t *builder, char const *format, va_list args)
+{
+    // Try in the free space first, and only format again if it was too small
+    va_list retry;
+    va_copy(retry, args);
+    size_t available = builder->capacity - builder->length;
+    int length = vsnprintf(builder->data + builder->length, available, format, args);
+    if (length < 0)
+    {
+        fputs(STR(__FILE__) ":" STR(__LINE__) "  Invalid format string\n", stderr);
+        abort();
+    }
+
+    if ((size_t)length >= available)
+    {
+        sbuilder_reserve(builder, length);
+        vsnprintf(builder->data + builder->length, length + 1, format, retry);
+    }
+    va_end(retry);
+
+    builder->length += length;
+}
+
+bool sbuilder_flush(string_builder_t *builder, FILE *fd)
+{
+    bool written = fwrite(builder->data, 1, builder->length, fd) == builder->length;
+    builder->length = 0;
+    builder->data[0] = '\0';
+    return written;
+}
+
+char *sbuilder_release(string_builder_t *builder)
+{
+    char *data = builder->data;
+    free(builder);
+    return data;
+}
+
+void sbuilder_free(string_builder_t *builder)
+{
+    free(builder->data);
+    free(builder);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+
+typedef struct
+{
+    char *data;      // Always NUL terminated
+    size_t length;   // Length of the string, without the terminating NUL
+    size_t capacity; // Allocated size of data
+} string_builder_t;
+
+/**
+ * @brief Initialise an empty string builder
+ *
+ * @return string_builder_t* The newly created string builder
+ */
+string_builder_t *sbuilder_init(void);
+
+/**
+ * @brief Make sure a number of bytes can be appended without reallocating
+ *
+ * @param builder The string builder
+ * @param size Number of bytes, without the terminating NUL
+ */
+void sbuilder_reserve(string_builder_t *builder, size_t size);
+
+/**
+ * @brief Append bytes to the string
+ *
+ * @param builder The string builder
+ * @param data The bytes to append, can contain NULs
+ * @param length Number of bytes
+ */
+void sbuilder_append(string_builder_t *builder, char const *data, size_t length);
+
+/**
+ * @brief Append a NUL terminated string
+ *
+ * @param builder The string builder
+ * @param str The string to append
+ */
+void sbuilder_puts(string_builder_t *builder, char const *str);
+
+/**
+ * @brief Append a character repeated several times
+ *
+ * @param builder The string builder
+ * @param c The character
+ * @param count Number of times it is appended
+ */
+void sbuilder_repeat(string_builder_t *builder, char c, size_t count);
+
+/**
+ * @brief Append formatted text, never truncated
+ *
+ * @param builder The string builder
+ * @param format printf-like format string
+ * @param ... Arguments
+ */
+void sbuilder_printf(string_builder_t *builder, char const *format, ...);
+
+/**
+ * @brief Append formatted text from a va_list, never truncated
+ *
+ * @param builder The string builder
+ * @param format printf-like format string
+ * @param args Arguments
+ */
+void sbuilder_vprintf(string_builder_t *builder, char const *format, va_list args);
+
+/**
+ * @brief Write the whole string to a file and empty the builder
+ *
+ * @param builder The string builder
+ * @param fd The file descriptor to write to
+ * @return true if every byte has been written
+ */
+bool sbuilder_flush(string_builder_t *builder, FILE *fd);
+
+/**
+ * @brief Free the builder and return its string
+ *
+ * @param builder The string builder, invalid after the call
+ * @return char* The string, to be released with free
+ */
+char *sbuilder_release(string_builder_t *builder);
+
+/**
+ * @brief Free the builder and its string
+ *
+ * @param builder The string builder
+ */
+void sbuilder_free(string_builder_t *builder);
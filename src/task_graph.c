@@ -0,0 +1,200 @@
+#include "task_graph.h"
+
+#include <pthread.h>
+#include <unistd.h>
+#include <stdatomic.h>
+
+#include "dynamic_array.h"
+#include "xmalloc.h"
+#include "failure.h"
+
+typedef struct
+{
+    task_function_t function;
+    void *argument;
+    int pending;          // Number of dependencies not done yet
+    darray_t *dependents; // Indexes of the tasks waiting for this one
+} task_t;
+
+struct task_graph_s
+{
+    darray_t *tasks;
+    int *ready; // Stack of the tasks that can run
+    int ready_count;
+    int done;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+};
+
+typedef struct
+{
+    atomic_int next;
+    int count;
+    void (*body)(int index, void *context);
+    void *context;
+} parallel_for_t;
+
+static int jobs = 0; // 0 until set or read the first time
+
+// Run the ready tasks until the whole graph is done
+static void *task_worker(void *data);
+// Run the remaining indexes of a parallel for
+static void *parallel_for_worker(void *data);
+// Start threads running a worker, and run it on the calling thread too
+static void run_workers(int count, void *(*worker)(void *), void *data);
+
+/*********************************************************************/
+
+void task_set_jobs(int _jobs)
+{
+    jobs = _jobs < 1 ? 1 : _jobs;
+}
+
+int task_get_jobs(void)
+{
+    if (jobs == 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = cpus < 1 ? 1 : cpus;
+    }
+    return jobs;
+}
+
+task_graph_t *task_graph_init(void)
+{
+    task_graph_t *graph = xmalloc(sizeof(task_graph_t));
+    graph->tasks = darray_init(sizeof(task_t));
+    graph->ready = NULL;
+    graph->ready_count = 0;
+    graph->done = 0;
+    return graph;
+}
+
+int task_graph_add(task_graph_t *graph, task_function_t function, void *argument)
+{
+    task_t task = {.function = function, .argument = argument, .pending = 0, .dependents = darray_init(sizeof(int))};
+    darray_add(&(graph->tasks), task);
+    return graph->tasks->count - 1;
+}
+
+void task_graph_depends(task_graph_t *graph, int task, int dependency)
+{
+    if (dependency >= task)
+    {
+        fail_error("Task %i can not wait for task %i, added after it", task, dependency);
+        abort();
+    }
+
+    task_t *tasks = darray_get_ptr(&(graph->tasks), 0);
+    darray_add(&(tasks[dependency].dependents), task);
+    tasks[task].pending++;
+}
+
+void task_graph_run(task_graph_t *graph)
+{
+    int count = graph->tasks->count;
+    task_t *tasks = darray_get_ptr(&(graph->tasks), 0);
+
+    // The dependencies are added before their dependents, so the order of addition is a valid order
+    if (task_get_jobs() == 1 || count <= 1)
+    {
+        for (int i = 0; i < count; i++)
+            tasks[i].function(tasks[i].argument);
+    }
+    else
+    {
+        graph->ready = xmalloc(sizeof(int) * count);
+        for (int i = count - 1; i >= 0; i--)
+        {
+            if (tasks[i].pending == 0)
+                graph->ready[graph->ready_count++] = i;
+        }
+
+        pthread_mutex_init(&graph->lock, NULL);
+        pthread_cond_init(&graph->wake, NULL);
+        run_workers(count < jobs ? count : jobs, task_worker, graph);
+        pthread_mutex_destroy(&graph->lock);
+        pthread_cond_destroy(&graph->wake);
+        free(graph->ready);
+    }
+
+    for (int i = 0; i < count; i++)
+        free(tasks[i].dependents);
+    free(graph->tasks);
+    free(graph);
+}
+
+void task_parallel_for(int count, void (*body)(int index, void *context), void *context)
+{
+    parallel_for_t loop = {.count = count, .body = body, .context = context};
+    atomic_init(&loop.next, 0);
+
+    int threads = task_get_jobs() < count ? jobs : count;
+    if (threads <= 1)
+        parallel_for_worker(&loop);
+    else
+        run_workers(threads, parallel_for_worker, &loop);
+}
+
+/*********************************************************************/
+
+static void *task_worker(void *data)
+{
+    task_graph_t *graph = data;
+    task_t *tasks = darray_get_ptr(&(graph->tasks), 0);
+
+    pthread_mutex_lock(&graph->lock);
+    while (graph->done < graph->tasks->count)
+    {
+        if (graph->ready_count == 0)
+        {
+            pthread_cond_wait(&graph->wake, &graph->lock);
+            continue;
+        }
+
+        int index = graph->ready[--graph->ready_count];
+        pthread_mutex_unlock(&graph->lock);
+        tasks[index].function(tasks[index].argument);
+        pthread_mutex_lock(&graph->lock);
+
+        // Release the tasks waiting for this one
+        graph->done++;
+        int *dependents = darray_get_ptr(&(tasks[index].dependents), 0);
+        for (size_t i = 0; i < tasks[index].dependents->count; i++)
+        {
+            if (--tasks[dependents[i]].pending == 0)
+                graph->ready[graph->ready_count++] = dependents[i];
+        }
+        pthread_cond_broadcast(&graph->wake);
+    }
+    pthread_mutex_unlock(&graph->lock);
+
+    return NULL;
+}
+
+static void *parallel_for_worker(void *data)
+{
+    parallel_for_t *loop = data;
+    int index;
+    while ((index = atomic_fetch_add(&loop->next, 1)) < loop->count)
+        loop->body(index, loop->context);
+    return NULL;
+}
+
+static void run_workers(int count, void *(*worker)(void *), void *data)
+{
+    pthread_t threads[count];
+    int started = 0;
+
+    // The calling thread is one of the workers. Without more threads, it does all the work
+    for (; started < count - 1; started++)
+    {
+        if (pthread_create(&threads[started], NULL, worker, data) != 0)
+            break;
+    }
+
+    worker(data);
+
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+typedef void (*task_function_t)(void *argument);
+
+typedef struct task_graph_s task_graph_t;
+
+/**
+ * @brief Set the number of threads the tasks can run on
+ *
+ * @param jobs Number of threads, 1 runs everything on the calling thread. The default is the number of CPUs online
+ */
+void task_set_jobs(int jobs);
+
+/**
+ * @brief Get the number of threads the tasks can run on
+ *
+ * @return int The number of threads, at least 1
+ */
+int task_get_jobs(void);
+
+/**
+ * @brief Initialise an empty task graph
+ *
+ * @return task_graph_t* The new task graph
+ */
+task_graph_t *task_graph_init(void);
+
+/**
+ * @brief Add a task to a graph
+ *
+ * @param graph The task graph
+ * @param function The function run by the task
+ * @param argument The argument given to the function
+ * @return int The index of the task in the graph
+ */
+int task_graph_add(task_graph_t *graph, task_function_t function, void *argument);
+
+/**
+ * @brief Make a task wait for the end of another one
+ *
+ * @param graph The task graph
+ * @param task Index of the waiting task
+ * @param dependency Index of the task it waits for, added before it
+ */
+void task_graph_depends(task_graph_t *graph, int task, int dependency);
+
+/**
+ * @brief Run every task of a graph, each as soon as its dependencies are done, and free the graph
+ *
+ * @param graph The task graph, invalid after the call
+ */
+void task_graph_run(task_graph_t *graph);
+
+/**
+ * @brief Call a function for each index of a range, in parallel, and wait for all of them
+ *
+ * @param count Number of indexes, from 0 to count - 1
+ * @param body The function called for each index
+ * @param context The context given to the function
+ */
+void task_parallel_for(int count, void (*body)(int index, void *context), void *context);
@@ -1,28 +1,46 @@
 #include "tokeniser.h"
 
 #include "failure.h"
+#include "task_graph.h"
+
+// Arguments of the construction of the sub-NFAs
+typedef struct
+{
+    const token_def_t *tokens_array;
+    state_machine_t *nfas;
+} token_nfas_t;
+
+static void token_nfa_task(int index, void *context)
+{
+    token_nfas_t *arrays = context;
+    arrays->nfas[index] = tokeniser_token_to_nfa(arrays->tokens_array[index]);
+}
 
 state_machine_t tokeniser_array_to_nfa(int count, const token_def_t *tokens_array)
 {
-    state_machine_t new_state_machine;
     state_machine_t merged_state_machine;
 
-    // Generate the first fsm
-    merged_state_machine = tokeniser_token_to_nfa(tokens_array[0]);
+    // The tokens are independent, but the merge renumbers the states so it stays in order
+    token_nfas_t arrays = {.tokens_array = tokens_array, .nfas = xmalloc(sizeof(state_machine_t) * count)};
+    task_parallel_for(count, token_nfa_task, &arrays);
 
+    merged_state_machine = arrays.nfas[0];
     for (size_t i = 1; i < count; i++)
     {
-        // Generate a new state machine and reduce if possible
-        new_state_machine = tokeniser_token_to_nfa(tokens_array[i]);
-        merged_state_machine = state_machine_merge(&merged_state_machine, &new_state_machine);
+        // Merge the next state machine and reduce if possible, the merge copies both of them
+        state_machine_t previous = merged_state_machine;
+        merged_state_machine = state_machine_merge(&previous, &(arrays.nfas[i]));
+        state_machine_destroy(&previous);
+        state_machine_destroy(&(arrays.nfas[i]));
         state_machine_reduce(&merged_state_machine);
     }
 
+    free(arrays.nfas);
     return merged_state_machine;
 }
 
-// Generate a state machine matching the provided string
-state_machine_t tokeniser_token_to_nfa(const token_def_t token)
+// Translate the pattern of a token to a sequence of characters and commands, commands are negative
+static darray_t *token_sequence(const token_def_t token)
 {
     darray_t* sequence = darray_init(sizeof(int));
     int processed_char;
@@ -161,5 +179,82 @@ state_machine_t tokeniser_token_to_nfa(const token_def_t token)
         }
         darray_add(&sequence, processed_char);
     }
-    return pattern_compiler(sequence->count, (int*)darray_get_ptr(&sequence, 0), token.id);
+    return sequence;
+}
+
+// Generate a state machine matching the provided string
+state_machine_t tokeniser_token_to_nfa(const token_def_t token)
+{
+    darray_t *sequence = token_sequence(token);
+    state_machine_t nfa = pattern_compiler(sequence->count, (int*)darray_get_ptr(&sequence, 0), token.id);
+    darray_destroy(&sequence);
+    return nfa;
+}
+
+bool tokeniser_is_literal(const token_def_t token)
+{
+    darray_t *sequence = token_sequence(token);
+    int *characters = darray_get_ptr(&sequence, 0);
+
+    // Only EOF is negative without being a command
+    bool literal = sequence->count > 0;
+    for (size_t i = 0; i < sequence->count && literal; i++)
+        literal = characters[i] >= -1;
+
+    darray_destroy(&sequence);
+    return literal;
+}
+
+state_machine_t tokeniser_literals_to_dfa(int count, const token_def_t *tokens_array)
+{
+    // The states are added in order, so their ids are their indexes
+    arena_t *arena = state_machine_arena_begin();
+    state_machine_t trie = state_machine_init();
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!tokeniser_is_literal(tokens_array[i]))
+            continue;
+
+        darray_t *sequence = token_sequence(tokens_array[i]);
+        int *characters = darray_get_ptr(&sequence, 0);
+
+        // Follow the prefix already in the trie, and add the rest
+        int state_id = 0;
+        for (size_t j = 0; j < sequence->count; j++)
+        {
+            state_t *state = darray_get_ptr(&(trie.states_tstate), state_id);
+            transistion_t *transitions = darray_get_ptr(&(state->transitions_ttrans), 0);
+            int next_id = -1;
+            for (size_t k = 0; k < state->transitions_ttrans->count; k++)
+            {
+                if (transitions[k].condition == characters[j])
+                {
+                    next_id = transitions[k].next_state_id;
+                    break;
+                }
+            }
+
+            if (next_id < 0)
+            {
+                next_id = trie.states_tstate->count;
+                state_add_transition(state, next_id, characters[j]);
+                state_t new_state = state_init_state(next_id);
+                new_state.end_state = false;
+                darray_add(&(trie.states_tstate), new_state);
+            }
+            state_id = next_id;
+        }
+
+        // The same literal in two tokens, priority is given to the lowest id like in the subset construction
+        state_t *end = darray_get_ptr(&(trie.states_tstate), state_id);
+        if (!end->end_state || tokens_array[i].id < end->output)
+            end->output = tokens_array[i].id;
+        end->end_state = true;
+
+        darray_destroy(&sequence);
+    }
+
+    state_machine_arena_end(&trie, arena);
+    return trie;
 }
@@ -11,6 +11,7 @@
 typedef struct
 {
     int id;
+    int token_class; // Id of the token seen by the parser, the value stays the payload of the token
     char *name;
     char *pattern;
     char *action;
@@ -33,3 +34,23 @@ state_machine_t tokeniser_array_to_nfa(int count, const token_def_t *tokens_arra
  * @return state_machine_t The nfa
  */
 state_machine_t tokeniser_token_to_nfa(const token_def_t token);
+
+/**
+ * @brief Check if the pattern of a token is a plain string, without any repetition, set or alternative
+ *
+ * @param token The token definition
+ * @return true if the token only matches a single string
+ */
+bool tokeniser_is_literal(const token_def_t token);
+
+/**
+ * @brief Generate a dfa matching the literal tokens of an array, built directly as a trie
+ *
+ * @details The tokens that are not literals are ignored. The trie is deterministic by
+ *          construction and needs no subset construction.
+ *
+ * @param count The number of tokens definitions
+ * @param tokens_array The array of tokens definitions
+ * @return state_machine_t The dfa, its state ids are their indexes
+ */
+state_machine_t tokeniser_literals_to_dfa(int count, const token_def_t *tokens_array);
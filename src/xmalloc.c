@@ -1,6 +1,7 @@
 #include "xmalloc.h"
 
-xmalloc_error_handler_t xmalloc_error_handler = xmalloc_default_handler;
+// Set by the generators of the lexer and the parser, which run concurrently
+_Atomic xmalloc_error_handler_t xmalloc_error_handler = xmalloc_default_handler;
 
 //Empty handler
 void xmalloc_default_handler(int err){}